@@ -0,0 +1,163 @@
+#include "best_shot_saver.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "box_utils.h"
+
+BestShotSaver::BestShotSaver(const char *output_dir, const char *class_name) : output_dir_(output_dir), class_name_(class_name)
+{
+	if (mkdir(output_dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+		printf("WARNING: Failed to create best-shot directory %s: %s\n", output_dir_.c_str(), strerror(errno));
+	}
+	det_index_.reserve(OBJ_NUMB_MAX_SIZE);
+}
+
+BestShotSaver::~BestShotSaver()
+{
+	flush_all();
+}
+
+void BestShotSaver::update(const detect_result_group_t &group, const cv::Mat &frame, long long pts, long long now_us)
+{
+	// Collect detections of the watched class
+	det_index_.clear();
+	for (int i = 0; i < group.count; i++) {
+		if (group.results[i].class_id == class_id_) {
+			det_index_.push_back(i);
+		}
+	}
+
+	det_used_.assign(det_index_.size(), false);
+	track_used_.assign(tracks_.size(), false);
+
+	// Greedy IoU association: repeatedly take the best remaining pair
+	while (true) {
+		float best_iou = iou_threshold_;
+		int best_t = -1, best_d = -1;
+		for (size_t t = 0; t < tracks_.size(); t++) {
+			if (track_used_[t]) {
+				continue;
+			}
+			for (size_t d = 0; d < det_index_.size(); d++) {
+				if (det_used_[d]) {
+					continue;
+				}
+				float iou = box_iou(tracks_[t].box, group.results[det_index_[d]].box);
+				if (iou > best_iou) {
+					best_iou = iou;
+					best_t = t;
+					best_d = d;
+				}
+			}
+		}
+		if (best_t < 0) {
+			break;
+		}
+
+		Track &track = tracks_[best_t];
+		const detect_result_t &det = group.results[det_index_[best_d]];
+		track.box = det.box;
+		track.missed = 0;
+		offer(track, det, frame, pts);
+		track_used_[best_t] = true;
+		det_used_[best_d] = true;
+	}
+
+	// Age unmatched tracks, flushing the ones that ended
+	for (size_t t = 0; t < tracks_.size(); t++) {
+		if (!track_used_[t]) {
+			tracks_[t].missed++;
+		}
+	}
+	for (auto it = tracks_.begin(); it != tracks_.end();) {
+		if (it->missed > max_missed_frames_) {
+			flush(*it);
+			it = tracks_.erase(it);
+			continue;
+		}
+		if (flush_interval_us_ > 0 && now_us - it->last_flush_us >= flush_interval_us_) {
+			flush(*it);
+			it->last_flush_us = now_us;
+		}
+		++it;
+	}
+
+	// Unmatched detections start new tracks
+	for (size_t d = 0; d < det_index_.size(); d++) {
+		if (det_used_[d]) {
+			continue;
+		}
+		Track track;
+		track.id = next_track_id_++;
+		track.box = group.results[det_index_[d]].box;
+		track.missed = 0;
+		track.last_flush_us = now_us;
+		track.has_shot = false;
+		track.best_score = 0.f;
+		track.best_prop = 0.f;
+		track.best_pts = 0;
+		offer(track, group.results[det_index_[d]], frame, pts);
+		tracks_.push_back(track);
+	}
+}
+
+void BestShotSaver::offer(Track &track, const detect_result_t &det, const cv::Mat &frame, long long pts)
+{
+	int x1 = std::max(0, det.box.left);
+	int y1 = std::max(0, det.box.top);
+	int x2 = std::min(frame.cols, det.box.right);
+	int y2 = std::min(frame.rows, det.box.bottom);
+	if (x2 <= x1 || y2 <= y1) {
+		return;
+	}
+
+	// Confidence first, size second: sqrt keeps area from swamping the score
+	float score = det.prop * sqrtf((float)(x2 - x1) * (y2 - y1));
+	if (track.has_shot && score <= track.best_score) {
+		return;
+	}
+
+	// The display buffer is overwritten every frame, so the crop must be copied
+	cv::Mat(frame, cv::Rect(x1, y1, x2 - x1, y2 - y1)).copyTo(track.best_crop);
+	track.best_score = score;
+	track.best_prop = det.prop;
+	track.best_pts = pts;
+	track.has_shot = true;
+}
+
+void BestShotSaver::flush(Track &track)
+{
+	if (!track.has_shot) {
+		return;
+	}
+
+	char file_name[256];
+	snprintf(file_name, sizeof(file_name), "%s/%s%s%lld_track%d_%s_%.1f.jpg", output_dir_.c_str(), source_name_.c_str(),
+		 source_name_.empty() ? "" : "_", track.best_pts, track.id, class_name_.c_str(), track.best_prop * 100);
+
+	try {
+		cv::imwrite(file_name, track.best_crop);
+		saved_count_++;
+		printf("Saved best shot: %s\n", file_name);
+	} catch (const std::exception &e) {
+		printf("Failed to save best shot: %s\n", e.what());
+	}
+
+	track.has_shot = false;
+	track.best_score = 0.f;
+}
+
+void BestShotSaver::flush_all()
+{
+	for (auto &track : tracks_) {
+		flush(track);
+	}
+	tracks_.clear();
+}
@@ -0,0 +1,100 @@
+#ifndef __BEST_SHOT_SAVER_H__
+#define __BEST_SHOT_SAVER_H__
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "config.h"
+#include "yolov5s_postprocess.h"
+
+// Keeps one crop per tracked object instead of one per frame.
+//
+// Detections of the watched class are associated across consecutive
+// detect_result_group_t results by greedy IoU matching. Each track keeps
+// only its best crop (confidence weighted by size) and writes it when the
+// track ends or when the flush interval elapses for long-lived tracks.
+class BestShotSaver {
+    public:
+	BestShotSaver(const char *output_dir = BEST_SHOT_DIR, const char *class_name = BEST_SHOT_CLASS);
+	~BestShotSaver();
+
+	// Feed one frame of detections; frame is the display image the boxes refer to.
+	void update(const detect_result_group_t &group, const cv::Mat &frame, long long pts, long long now_us);
+
+	// Write out every pending best shot and drop all tracks.
+	void flush_all();
+
+	void set_flush_interval_ms(int ms)
+	{
+		flush_interval_us_ = (long long)ms * 1000;
+	}
+	void set_iou_threshold(float iou)
+	{
+		iou_threshold_ = iou;
+	}
+	void set_max_missed_frames(int frames)
+	{
+		max_missed_frames_ = frames;
+	}
+	// The model's id for class_name; nothing is saved until it is set
+	void set_class_id(int id)
+	{
+		class_id_ = id;
+	}
+	// Prefixed to every file name, so savers sharing a directory cannot overwrite each other
+	void set_source_name(const std::string &name)
+	{
+		source_name_ = name;
+	}
+	const std::string &class_name() const
+	{
+		return class_name_;
+	}
+
+	int active_tracks() const
+	{
+		return (int)tracks_.size();
+	}
+	int saved_count() const
+	{
+		return saved_count_;
+	}
+
+    private:
+	struct Track {
+		int id;
+		BOX_RECT box; // last matched box, used for association
+		int missed;
+		long long last_flush_us;
+
+		bool has_shot;
+		float best_score;
+		float best_prop;
+		long long best_pts;
+		cv::Mat best_crop;
+	};
+
+	std::string output_dir_;
+	std::string class_name_;
+	std::string source_name_;
+	int class_id_ = -1;
+	float iou_threshold_ = BEST_SHOT_IOU_THRESH;
+	int max_missed_frames_ = BEST_SHOT_MAX_MISSED;
+	long long flush_interval_us_ = (long long)BEST_SHOT_FLUSH_INTERVAL_MS * 1000;
+
+	std::vector<Track> tracks_;
+	int next_track_id_ = 1;
+	int saved_count_ = 0;
+
+	// Scratch for association, kept to avoid per-frame allocation
+	std::vector<int> det_index_;
+	std::vector<bool> det_used_;
+	std::vector<bool> track_used_;
+
+	void offer(Track &track, const detect_result_t &det, const cv::Mat &frame, long long pts);
+	void flush(Track &track);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "box_utils.h"
+
+#include <string.h>
+
+void merge_tile_detections(std::vector<detect_result_t> &candidates, float iou_thresh, float ios_thresh, detect_result_group_t *out)
+{
+	out->clear();
+
+	std::sort(candidates.begin(), candidates.end(),
+		  [](const detect_result_t &a, const detect_result_t &b) { return a.prop > b.prop; });
+
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (candidates[i].prop <= 0.f) {
+			continue;
+		}
+		detect_result_t kept = candidates[i];
+		for (size_t j = i + 1; j < candidates.size(); j++) {
+			detect_result_t &other = candidates[j];
+			if (other.prop <= 0.f || kept.class_id != other.class_id) {
+				continue;
+			}
+			if (box_iou(kept.box, other.box) > iou_thresh) {
+				other.prop = 0.f;
+			} else if (box_ios(kept.box, other.box) > ios_thresh) {
+				// Partial view of the same object: grow the kept box to cover both
+				kept.box.left = std::min(kept.box.left, other.box.left);
+				kept.box.top = std::min(kept.box.top, other.box.top);
+				kept.box.right = std::max(kept.box.right, other.box.right);
+				kept.box.bottom = std::max(kept.box.bottom, other.box.bottom);
+				other.prop = 0.f;
+			}
+		}
+		out->add() = kept;
+	}
+}
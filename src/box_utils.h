@@ -0,0 +1,65 @@
+#ifndef __BOX_UTILS_H__
+#define __BOX_UTILS_H__
+
+#include <algorithm>
+#include <vector>
+
+#include "yolov5s_postprocess.h"
+
+// Intersection over union of two boxes in pixel coordinates
+inline float box_iou(const BOX_RECT &a, const BOX_RECT &b)
+{
+	int iw = std::min(a.right, b.right) - std::max(a.left, b.left);
+	int ih = std::min(a.bottom, b.bottom) - std::max(a.top, b.top);
+	if (iw <= 0 || ih <= 0) {
+		return 0.f;
+	}
+	float inter = (float)iw * ih;
+	float area_a = (float)(a.right - a.left) * (a.bottom - a.top);
+	float area_b = (float)(b.right - b.left) * (b.bottom - b.top);
+	float uni = area_a + area_b - inter;
+	return uni <= 0.f ? 0.f : inter / uni;
+}
+
+// Intersection over the smaller box's area; a box cut at a tile seam is
+// mostly contained in the whole detection from the neighbouring tile
+inline float box_ios(const BOX_RECT &a, const BOX_RECT &b)
+{
+	int iw = std::min(a.right, b.right) - std::max(a.left, b.left);
+	int ih = std::min(a.bottom, b.bottom) - std::max(a.top, b.top);
+	if (iw <= 0 || ih <= 0) {
+		return 0.f;
+	}
+	float area_a = (float)(a.right - a.left) * (a.bottom - a.top);
+	float area_b = (float)(b.right - b.left) * (b.bottom - b.top);
+	float smaller = std::min(area_a, area_b);
+	return smaller <= 0.f ? 0.f : (float)iw * ih / smaller;
+}
+
+// Maps boxes from model input coordinates back to display coordinates:
+// display = model * scale + offset. Covers plain resizing as well as
+// crops, where the offset is the crop origin in display space.
+struct BoxTransform {
+	float scale_x = 1.f;
+	float scale_y = 1.f;
+	float offset_x = 0.f;
+	float offset_y = 0.f;
+
+	BOX_RECT apply(const BOX_RECT &b) const
+	{
+		BOX_RECT out;
+		out.left = (int)(b.left * scale_x + offset_x);
+		out.right = (int)(b.right * scale_x + offset_x);
+		out.top = (int)(b.top * scale_y + offset_y);
+		out.bottom = (int)(b.bottom * scale_y + offset_y);
+		return out;
+	}
+};
+
+// Cross-tile NMS for detections gathered from overlapping tiles, already in
+// display coordinates. Same-class boxes overlapping by more than iou_thresh
+// are suppressed; boxes mostly contained in a stronger one (ios_thresh) are
+// merged into it, which rejoins objects split by a tile seam.
+void merge_tile_detections(std::vector<detect_result_t> &candidates, float iou_thresh, float ios_thresh, detect_result_group_t *out);
+
+#endif
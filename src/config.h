@@ -21,11 +21,81 @@
 #define ENABLE_MULTITHREADED_CONVERSION 1
 #define SOFTWARE_PROCESSING_THREADS 2
 
+// Best-shot crop saving: one crop per tracked object instead of one per frame
+#define BEST_SHOT_DIR "./detections"
+#define BEST_SHOT_CLASS "person"
+#define BEST_SHOT_IOU_THRESH 0.3f // minimum IoU to continue a track
+#define BEST_SHOT_MAX_MISSED 15 // frames a track may go unseen before it is closed
+#define BEST_SHOT_FLUSH_INTERVAL_MS 10000 // long-lived tracks still save once per interval
+
+// Object tracking between inference frames
+#define INFERENCE_INTERVAL_DEFAULT 1 // run the detector every Nth frame at most
+#define TRACKER_IOU_THRESH 0.3f // minimum IoU between prediction and detection to match
+#define TRACKER_MIN_HITS 2 // matches before a track is shown on skipped frames
+#define TRACKER_MAX_AGE 3 // inference updates a confirmed track may miss before removal
+#define TRACKER_STABLE_IOU 0.6f // mean match IoU below this resets the interval to 1
+#define TRACKER_STABLE_UPDATES 2 // stable inference updates before the interval grows
+#define TRACKER_MAX_ELAPSED_FRAMES 300 // pts gaps longer than this many frames (seeks, restarts) count as one frame
+
+// Motion gating of inference on static scenes
+#define MOTION_THUMB_W 64 // luma thumbnail size used for change detection
+#define MOTION_THUMB_H 36
+#define MOTION_PIXEL_THRESH 12 // per-cell luma difference counted as change
+#define MOTION_GATE_DEFAULT false // opt-in: skipping inference on static scenes changes what gets detected
+#define MOTION_THRESHOLD_DEFAULT 0.005f // fraction of changed cells that triggers inference
+#define MOTION_HEARTBEAT_MS 2000 // inference runs at least this often regardless of motion
+#define MJPEG_STATIC_REFRESH_MS 1000 // unchanged frames are still re-encoded this often
+
+// Tiled inference for high-resolution sources
+#define TILE_MAX_COUNT 16 // upper bound on tiles per frame
+#define MODEL_INPUT_MAX_COUNT (TILE_MAX_COUNT + 1) // model input buffers per channel: every tile plus the full-frame pass
+#define TILE_OVERLAP_DEFAULT 0.2f // tile overlap as a fraction of the tile size
+#define TILE_MERGE_IOS_THRESH 0.7f // containment above which a seam-cut box is merged into its neighbour
+
+// Non-maximum suppression
+#define NMS_TOPK 1024 // highest-scoring candidates NMS looks at; the rest are dropped before sorting
+#define NMS_GRID_CELLS 8 // busy frames bucket kept boxes on an N x N grid; 0 always compares against every kept box
+#define NMS_GRID_MIN_CANDIDATES 256 // candidates from which the grid is used
+#define DETECT_CLASSES_DEFAULT "" // comma-separated labels a channel detects, e.g. "person"; "" detects every class
+
+// Aspect-preserving model input
+#define LETTERBOX_DEFAULT true // letterbox crops into the model input instead of stretching
+#define LETTERBOX_PAD_VALUE 114 // YOLO training pad gray
+#define LETTERBOX_PAD_COLOR 0xFF727272 // same gray as an RGA fill color
+
+// Cross-channel batched inference
+#define INFERENCE_BATCH_MODEL_PATH "" // batch-N model shared by all channels; "" disables, "mock" runs without the NPU
+#define INFERENCE_BATCH_MAX_WAIT_US 5000 // longest a frame waits for the rest of its batch
+#define INFERENCE_BATCH_MOCK_SIZE 4 // batch size of the mock backend
+
+// NPU scheduling between channels
+#define NPU_CORE_COUNT 3 // RK3588 NPU cores; without a batch broker this many channels may infer at once
+#define NPU_SCHED_DEFAULT_WEIGHT 1.0f // share of spare NPU time relative to other channels
+#define NPU_SCHED_DEFAULT_FPS 5.0f // inference rate a channel is entitled to before fair sharing
+#define NPU_SCHED_DEFAULT_DEADLINE_MS 200 // frames older than this when the NPU frees up are dropped
+#define NPU_SCHED_REPORT_MS 10000 // period of the per-channel achieved rate report
+
+// Live decode
+#define LIVE_MODE_DEFAULT true // network streams process only the newest decoded frame
+#define DECODE_NONREF_MIN_INTERVAL 2 // inference interval (frames) from which non-reference frames are not decoded
+#define FILE_LOOP_DEFAULT true // files restart by seeking instead of reopening
+#define OPEN_PROFILE_DEFAULT "auto" // probing profile: "default", "camera", "fast" or "auto"
+
+// DMA buffers
+#define DMA_ALLOCATOR_DEFAULT "auto" // "drm", "heap-system", "heap-cma", "malloc" or "auto"; DMA_ALLOCATOR env overrides
+#define DMABUF_MAP_CACHE_MAX 32 // decoder surface mappings kept per channel (rkmpp pools hold fewer)
+#define SW_DECODE_DMA_FRAMES true // software decoders write frames into pool buffers so RGA can convert them
+#define SW_DECODE_DMA_ALLOCATOR "heap-system" // cached backend for those frames, decoders read references back; "" uses the channel's
+
+// Start-up
+#define MODEL_WARMUP true // one blank inference per context before the first frame
+
 struct drm_buf {
 	int drm_buf_fd = -1;
 	unsigned int drm_buf_handle;
 	void *drm_buf_ptr = NULL;
 	size_t drm_buf_size = 0;
+	int drm_buf_pitch = 0; // bytes per row as allocated; DRM dumb buffers pad it (64 bytes on Rockchip)
 };
 
 long long current_timestamp();
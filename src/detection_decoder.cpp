@@ -0,0 +1,364 @@
+#include "detection_decoder.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+static const int NUM_LEVELS = 3;
+static const int LEVEL_STRIDES[NUM_LEVELS] = { 8, 16, 32 };
+static const int YOLOV5_ANCHORS[NUM_LEVELS][6] = { { 10, 13, 16, 30, 33, 23 }, { 30, 61, 62, 45, 59, 119 }, { 116, 90, 156, 198, 373, 326 } };
+
+static inline float sigmoid(float x)
+{
+	return 1.0f / (1.0f + expf(-x));
+}
+
+static inline float unsigmoid(float y)
+{
+	return -1.0f * logf((1.0f / y) - 1.0f);
+}
+
+static inline int8_t qnt_f32_to_affine(float f32, int32_t zp, float scale)
+{
+	float dst_val = (f32 / scale) + zp;
+	dst_val = dst_val <= -128 ? -128 : (dst_val >= 127 ? 127 : dst_val);
+	return (int8_t)dst_val;
+}
+
+static inline float deqnt_affine_to_f32(int8_t qnt, int32_t zp, float scale)
+{
+	return ((float)qnt - (float)zp) * scale;
+}
+
+// Anchor-based head: per level one [1, 3 * (5 + classes), h, w] tensor.
+// NC > 0 fixes the class count at compile time; NC == 0 reads it at runtime.
+template <int NC>
+class Yolov5Decoder : public DetectionDecoder {
+    public:
+	explicit Yolov5Decoder(int num_classes)
+	{
+		num_classes_ = NC > 0 ? NC : num_classes;
+	}
+
+	const char *name() const override
+	{
+		return NC > 0 ? "yolov5 (specialized)" : "yolov5 (generic)";
+	}
+
+	bool accepts(const rknn_tensor_attr *output_attrs, int n_output) const override
+	{
+		return n_output >= NUM_LEVELS && (int)output_attrs[0].dims[1] == 3 * (5 + num_classes_);
+	}
+
+	int decode(int8_t *const *outputs, const rknn_tensor_attr *output_attrs, int model_in_h, int model_in_w, float conf_threshold,
+		   float nms_threshold, detect_result_group_t *group) override
+	{
+		scratch_.clear();
+		for (int l = 0; l < NUM_LEVELS; l++) {
+			int stride = LEVEL_STRIDES[l];
+			decode_level(outputs[l], YOLOV5_ANCHORS[l], model_in_h / stride, model_in_w / stride, stride, conf_threshold,
+				     output_attrs[l].zp, output_attrs[l].scale);
+		}
+		return filter_detections(scratch_, model_in_h, model_in_w, nms_threshold, 1.0f, 1.0f, label_ptrs_.data(), num_classes_, group);
+	}
+
+    private:
+	void decode_level(const int8_t *input, const int *anchor, int grid_h, int grid_w, int stride, float threshold, int32_t zp, float scale)
+	{
+		const int nc = NC > 0 ? NC : num_classes_;
+		const int prop_size = 5 + nc;
+		const int grid_len = grid_h * grid_w;
+		const int8_t thres_i8 = qnt_f32_to_affine(unsigmoid(threshold), zp, scale);
+
+		for (int a = 0; a < 3; a++) {
+			const int8_t *conf = input + (prop_size * a + 4) * grid_len;
+			for (int i = 0; i < grid_h; i++) {
+				for (int j = 0; j < grid_w; j++) {
+					if (conf[i * grid_w + j] < thres_i8) {
+						continue;
+					}
+					const int8_t *in_ptr = input + (prop_size * a) * grid_len + i * grid_w + j;
+					int max_class;
+					int8_t max_prob;
+					if (class_subset_) {
+						// Only the allowed classes' planes are read
+						max_class = classes_[0];
+						max_prob = in_ptr[(5 + max_class) * grid_len];
+						for (size_t s = 1; s < classes_.size(); ++s) {
+							int8_t prob = in_ptr[(5 + classes_[s]) * grid_len];
+							if (prob > max_prob) {
+								max_class = classes_[s];
+								max_prob = prob;
+							}
+						}
+					} else {
+						max_prob = in_ptr[5 * grid_len];
+						max_class = 0;
+						for (int k = 1; k < nc; ++k) {
+							int8_t prob = in_ptr[(5 + k) * grid_len];
+							if (prob > max_prob) {
+								max_class = k;
+								max_prob = prob;
+							}
+						}
+					}
+
+					float box_x = sigmoid(deqnt_affine_to_f32(in_ptr[0], zp, scale)) * 2.0f - 0.5f;
+					float box_y = sigmoid(deqnt_affine_to_f32(in_ptr[grid_len], zp, scale)) * 2.0f - 0.5f;
+					float box_w = sigmoid(deqnt_affine_to_f32(in_ptr[2 * grid_len], zp, scale)) * 2.0f;
+					float box_h = sigmoid(deqnt_affine_to_f32(in_ptr[3 * grid_len], zp, scale)) * 2.0f;
+					box_x = (box_x + j) * (float)stride;
+					box_y = (box_y + i) * (float)stride;
+					box_w = box_w * box_w * (float)anchor[a * 2];
+					box_h = box_h * box_h * (float)anchor[a * 2 + 1];
+					scratch_.boxes.push_back(box_x - box_w / 2.0f);
+					scratch_.boxes.push_back(box_y - box_h / 2.0f);
+					scratch_.boxes.push_back(box_w);
+					scratch_.boxes.push_back(box_h);
+					scratch_.probs.push_back(sigmoid(deqnt_affine_to_f32(max_prob, zp, scale)));
+					scratch_.class_ids.push_back(max_class);
+				}
+			}
+		}
+	}
+};
+
+// Anchor-free head as exported by the RKNN model zoo: per level a DFL box
+// tensor [1, 4 * bins, h, w], class scores [1, classes, h, w] with sigmoid
+// already applied, and optionally a [1, 1, h, w] score sum used to skip
+// empty cells cheaply.
+template <int NC>
+class Yolov8Decoder : public DetectionDecoder {
+    public:
+	Yolov8Decoder(int num_classes, int outputs_per_level, int dfl_len) : outputs_per_level_(outputs_per_level), dfl_len_(dfl_len)
+	{
+		num_classes_ = NC > 0 ? NC : num_classes;
+		dfl_.resize(4 * dfl_len_);
+	}
+
+	const char *name() const override
+	{
+		return NC > 0 ? "yolov8 (specialized)" : "yolov8 (generic)";
+	}
+
+	bool accepts(const rknn_tensor_attr *output_attrs, int n_output) const override
+	{
+		return n_output == NUM_LEVELS * outputs_per_level_ && (int)output_attrs[0].dims[1] == 4 * dfl_len_ &&
+		       (int)output_attrs[1].dims[1] == num_classes_;
+	}
+
+	int decode(int8_t *const *outputs, const rknn_tensor_attr *output_attrs, int model_in_h, int model_in_w, float conf_threshold,
+		   float nms_threshold, detect_result_group_t *group) override
+	{
+		scratch_.clear();
+		for (int l = 0; l < NUM_LEVELS; l++) {
+			int base = l * outputs_per_level_;
+			int stride = LEVEL_STRIDES[l];
+			const rknn_tensor_attr *sum_attr = outputs_per_level_ > 2 ? &output_attrs[base + 2] : nullptr;
+			decode_level(outputs[base], output_attrs[base], outputs[base + 1], output_attrs[base + 1],
+				     sum_attr ? outputs[base + 2] : nullptr, sum_attr, model_in_h / stride, model_in_w / stride, stride,
+				     conf_threshold);
+		}
+		return filter_detections(scratch_, model_in_h, model_in_w, nms_threshold, 1.0f, 1.0f, label_ptrs_.data(), num_classes_, group);
+	}
+
+    private:
+	int outputs_per_level_;
+	int dfl_len_;
+	std::vector<float> dfl_;
+
+	void decode_level(const int8_t *box, const rknn_tensor_attr &box_attr, const int8_t *cls, const rknn_tensor_attr &cls_attr,
+			  const int8_t *score_sum, const rknn_tensor_attr *sum_attr, int grid_h, int grid_w, int stride, float threshold)
+	{
+		const int nc = NC > 0 ? NC : num_classes_;
+		const int grid_len = grid_h * grid_w;
+		const int8_t score_thres_i8 = qnt_f32_to_affine(threshold, cls_attr.zp, cls_attr.scale);
+		const int8_t sum_thres_i8 = sum_attr ? qnt_f32_to_affine(threshold, sum_attr->zp, sum_attr->scale) : 0;
+
+		for (int i = 0; i < grid_h; i++) {
+			for (int j = 0; j < grid_w; j++) {
+				int offset = i * grid_w + j;
+				if (score_sum && score_sum[offset] < sum_thres_i8) {
+					continue;
+				}
+
+				int8_t max_score = -128;
+				int max_class = -1;
+				if (class_subset_) {
+					// Only the allowed classes' planes are read
+					for (int c : classes_) {
+						int8_t score = cls[c * grid_len + offset];
+						if (score > score_thres_i8 && score > max_score) {
+							max_score = score;
+							max_class = c;
+						}
+					}
+				} else {
+					for (int c = 0; c < nc; c++) {
+						int8_t score = cls[c * grid_len + offset];
+						if (score > score_thres_i8 && score > max_score) {
+							max_score = score;
+							max_class = c;
+						}
+					}
+				}
+				if (max_class < 0) {
+					continue;
+				}
+
+				// Each side is a distribution over dfl_len_ bins; its expectation is the distance
+				float dist[4];
+				for (int k = 0; k < 4; k++) {
+					float *bins = &dfl_[k * dfl_len_];
+					float max_bin = -1e9f;
+					for (int b = 0; b < dfl_len_; b++) {
+						bins[b] = deqnt_affine_to_f32(box[(k * dfl_len_ + b) * grid_len + offset], box_attr.zp, box_attr.scale);
+						max_bin = bins[b] > max_bin ? bins[b] : max_bin;
+					}
+					float sum = 0.f, acc = 0.f;
+					for (int b = 0; b < dfl_len_; b++) {
+						float e = expf(bins[b] - max_bin);
+						sum += e;
+						acc += e * b;
+					}
+					dist[k] = acc / sum;
+				}
+
+				float x1 = (-dist[0] + j + 0.5f) * stride;
+				float y1 = (-dist[1] + i + 0.5f) * stride;
+				float x2 = (dist[2] + j + 0.5f) * stride;
+				float y2 = (dist[3] + i + 0.5f) * stride;
+				scratch_.boxes.push_back(x1);
+				scratch_.boxes.push_back(y1);
+				scratch_.boxes.push_back(x2 - x1);
+				scratch_.boxes.push_back(y2 - y1);
+				scratch_.probs.push_back(deqnt_affine_to_f32(max_score, cls_attr.zp, cls_attr.scale));
+				scratch_.class_ids.push_back(max_class);
+			}
+		}
+	}
+};
+
+// Label files are read once per (path, class count); later decoders share the result
+static std::shared_ptr<const std::vector<std::string> > shared_labels(const char *labels_path, int num_classes)
+{
+	static std::mutex mutex;
+	static std::map<std::pair<std::string, int>, std::shared_ptr<const std::vector<std::string> > > cache;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto key = std::make_pair(std::string(labels_path ? labels_path : ""), num_classes);
+	auto it = cache.find(key);
+	if (it != cache.end()) {
+		return it->second;
+	}
+
+	std::vector<char *> lines(num_classes, nullptr);
+	int n = labels_path ? readLines(labels_path, lines.data(), num_classes) : 0;
+
+	std::shared_ptr<std::vector<std::string> > labels = std::make_shared<std::vector<std::string> >();
+	for (int i = 0; i < num_classes; i++) {
+		if (i < n && lines[i]) {
+			labels->push_back(lines[i]);
+			free(lines[i]);
+		} else {
+			labels->push_back("class" + std::to_string(i));
+		}
+	}
+	cache[key] = labels;
+	return labels;
+}
+
+void DetectionDecoder::load_labels(const char *labels_path)
+{
+	labels_ = shared_labels(labels_path, num_classes_);
+	label_ptrs_.clear();
+	for (const auto &label : *labels_) {
+		label_ptrs_.push_back(label.c_str());
+	}
+}
+
+int DetectionDecoder::set_class_filter(const std::vector<int> &class_ids)
+{
+	for (int id : class_ids) {
+		if (id < 0 || id >= num_classes_) {
+			printf("ERROR: class id %d out of range (model has %d classes)\n", id, num_classes_);
+			return -1;
+		}
+	}
+	classes_ = class_ids;
+	std::sort(classes_.begin(), classes_.end());
+	classes_.erase(std::unique(classes_.begin(), classes_.end()), classes_.end());
+	class_subset_ = !classes_.empty() && (int)classes_.size() < num_classes_;
+	return 0;
+}
+
+int DetectionDecoder::class_id(const char *label) const
+{
+	for (int i = 0; i < (int)label_ptrs_.size(); i++) {
+		if (strcmp(label_ptrs_[i], label) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool DetectionDecoder::detects(int class_id) const
+{
+	if (class_id < 0 || class_id >= num_classes_) {
+		return false;
+	}
+	return !class_subset_ || std::binary_search(classes_.begin(), classes_.end(), class_id);
+}
+
+std::unique_ptr<DetectionDecoder> DetectionDecoder::create(const std::string &type, const char *custom_string,
+							   const rknn_tensor_attr *output_attrs, int n_output, const char *labels_path)
+{
+	std::string head = type;
+	if (head == "auto" && custom_string) {
+		if (strstr(custom_string, "yolov8")) {
+			head = "yolov8";
+		} else if (strstr(custom_string, "yolov5")) {
+			head = "yolov5";
+		}
+	}
+	if (head == "auto") {
+		// Fall back to recognising the output layout
+		if (n_output == NUM_LEVELS && output_attrs[0].dims[1] % 3 == 0 && (int)output_attrs[0].dims[1] / 3 > 5) {
+			head = "yolov5";
+		} else if ((n_output == 2 * NUM_LEVELS || n_output == 3 * NUM_LEVELS) && output_attrs[0].dims[1] % 4 == 0) {
+			head = "yolov8";
+		}
+	}
+
+	std::unique_ptr<DetectionDecoder> decoder;
+	if (head == "yolov5" && n_output >= NUM_LEVELS) {
+		int nc = (int)output_attrs[0].dims[1] / 3 - 5;
+		if (nc == OBJ_CLASS_NUM) {
+			decoder.reset(new Yolov5Decoder<OBJ_CLASS_NUM>(nc));
+		} else if (nc > 0) {
+			decoder.reset(new Yolov5Decoder<0>(nc));
+		}
+	} else if (head == "yolov8" && n_output >= 2 * NUM_LEVELS) {
+		int per_level = n_output / NUM_LEVELS;
+		int nc = (int)output_attrs[1].dims[1];
+		int dfl_len = (int)output_attrs[0].dims[1] / 4;
+		if (nc == OBJ_CLASS_NUM) {
+			decoder.reset(new Yolov8Decoder<OBJ_CLASS_NUM>(nc, per_level, dfl_len));
+		} else if (nc > 0) {
+			decoder.reset(new Yolov8Decoder<0>(nc, per_level, dfl_len));
+		}
+	}
+
+	if (!decoder) {
+		printf("ERROR: No detection decoder for type '%s' with %d outputs\n", type.c_str(), n_output);
+		return nullptr;
+	}
+
+	decoder->load_labels(labels_path);
+	printf("Detection decoder: %s, %d classes, labels from %s\n", decoder->name(), decoder->num_classes(), labels_path ? labels_path : "(none)");
+	return decoder;
+}
@@ -0,0 +1,79 @@
+#ifndef __DETECTION_DECODER_H__
+#define __DETECTION_DECODER_H__
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rknn_api.h"
+#include "yolov5s_postprocess.h"
+
+// Decodes the raw int8 outputs of a detection head into model-space boxes.
+//
+// One implementation per head family (anchor-based YOLOv5, anchor-free
+// YOLOv8 with DFL boxes). Each is a template over the class count so the
+// common 80-class case gets inner loops with constant trip counts; other
+// class counts use the same code with a runtime count.
+//
+// A decoder belongs to one channel: decode() only touches its own scratch
+// and the shared read-only labels, so channels decode concurrently, and a
+// frame allocates nothing once the scratch has grown to the busiest scene.
+class DetectionDecoder {
+    public:
+	virtual ~DetectionDecoder() {}
+
+	virtual const char *name() const = 0;
+
+	// Whether outputs laid out like output_attrs are this head with this class
+	// count, i.e. decode() can be fed them
+	virtual bool accepts(const rknn_tensor_attr *output_attrs, int n_output) const = 0;
+
+	// Boxes come back in model input pixels; NMS is already applied
+	virtual int decode(int8_t *const *outputs, const rknn_tensor_attr *output_attrs, int model_in_h, int model_in_w, float conf_threshold,
+			   float nms_threshold, detect_result_group_t *group) = 0;
+
+	int num_classes() const
+	{
+		return num_classes_;
+	}
+
+	// Decode only these classes; empty decodes all. The other classes' score
+	// planes are never read, and allowed classes are scored exactly as without
+	// a filter. Returns -1, leaving the filter unchanged, if an id is out of range.
+	int set_class_filter(const std::vector<int> &class_ids);
+
+	// The class labelled label, or -1 if the model has none
+	int class_id(const char *label) const;
+
+	// Whether decode() can report class_id under the current filter
+	bool detects(int class_id) const;
+
+	// Pick a decoder for the model. type is "auto", "yolov5" or "yolov8"; with
+	// "auto" the model's custom string is consulted first, then the output
+	// layout. Returns nullptr when the layout matches no known head.
+	static std::unique_ptr<DetectionDecoder> create(const std::string &type, const char *custom_string, const rknn_tensor_attr *output_attrs,
+							int n_output, const char *labels_path);
+
+    protected:
+	DetectionDecoder()
+	{
+		scratch_.reserve(OBJ_CANDIDATE_RESERVE);
+	}
+
+	int num_classes_ = 0;
+	// Read once per process and shared by every decoder of the same file; never modified
+	std::shared_ptr<const std::vector<std::string> > labels_;
+	std::vector<const char *> label_ptrs_;
+
+	// Candidate scratch, reused between frames
+	DetectionScratch scratch_;
+
+	// Allow-list set by set_class_filter, ascending; only consulted when class_subset_
+	std::vector<int> classes_;
+	bool class_subset_ = false;
+
+	void load_labels(const char *labels_path);
+};
+
+#endif
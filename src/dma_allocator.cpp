@@ -0,0 +1,230 @@
+#include "dma_allocator.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "drm_func.h"
+
+// Older BSP kernel headers predate dma-heap; the uapi is small and stable
+#if defined(__has_include)
+#if __has_include(<linux/dma-heap.h>)
+#include <linux/dma-heap.h>
+#endif
+#endif
+#ifndef DMA_HEAP_IOCTL_ALLOC
+struct dma_heap_allocation_data {
+	unsigned long long len;
+	unsigned int fd;
+	unsigned int fd_flags;
+	unsigned long long heap_flags;
+};
+#define DMA_HEAP_IOC_MAGIC 'H'
+#define DMA_HEAP_IOCTL_ALLOC _IOWR(DMA_HEAP_IOC_MAGIC, 0x0, struct dma_heap_allocation_data)
+#endif
+
+static size_t page_align(size_t size)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	return (size + page - 1) / page * page;
+}
+
+class DrmDumbAllocator : public DmaAllocator {
+    public:
+	DrmDumbAllocator()
+	{
+		memset(&drm_ctx_, 0, sizeof(drm_ctx_));
+		drm_fd_ = rknn_drm_init(&drm_ctx_);
+	}
+	~DrmDumbAllocator()
+	{
+		if (drm_fd_ >= 0) {
+			rknn_drm_deinit(&drm_ctx_, drm_fd_);
+		}
+	}
+	bool ok() const
+	{
+		return drm_fd_ >= 0;
+	}
+
+	const char *name() const override
+	{
+		return "drm";
+	}
+	bool exports_fd() const override
+	{
+		return true;
+	}
+	int allocate(int width, int rows, int bpp, struct drm_buf *buf) override
+	{
+		unsigned int pitch = 0;
+		buf->drm_buf_ptr = rknn_drm_buf_alloc(&drm_ctx_, drm_fd_, width, rows, bpp, &buf->drm_buf_fd, &buf->drm_buf_handle,
+						      &buf->drm_buf_size, &pitch);
+		if (!buf->drm_buf_ptr || buf->drm_buf_fd < 0) {
+			buf->drm_buf_ptr = NULL;
+			return -1;
+		}
+		// The driver picks the pitch; rows are not width * bpp / 8 apart in general
+		buf->drm_buf_pitch = pitch ? (int)pitch : width * bpp / 8;
+		return 0;
+	}
+	void release(struct drm_buf *buf) override
+	{
+		rknn_drm_buf_destroy(&drm_ctx_, drm_fd_, buf->drm_buf_fd, buf->drm_buf_handle, buf->drm_buf_ptr, buf->drm_buf_size);
+	}
+
+    private:
+	drm_context drm_ctx_;
+	int drm_fd_ = -1;
+};
+
+class DmaHeapAllocator : public DmaAllocator {
+    public:
+	DmaHeapAllocator(const char *name, const char *const *paths) : name_(name)
+	{
+		for (int i = 0; paths[i] && heap_fd_ < 0; i++) {
+			heap_fd_ = open(paths[i], O_RDWR | O_CLOEXEC);
+		}
+	}
+	~DmaHeapAllocator()
+	{
+		if (heap_fd_ >= 0) {
+			close(heap_fd_);
+		}
+	}
+	bool ok() const
+	{
+		return heap_fd_ >= 0;
+	}
+
+	const char *name() const override
+	{
+		return name_;
+	}
+	bool exports_fd() const override
+	{
+		return true;
+	}
+	int allocate(int width, int rows, int bpp, struct drm_buf *buf) override
+	{
+		struct dma_heap_allocation_data data;
+		memset(&data, 0, sizeof(data));
+		data.len = page_align((size_t)width * rows * bpp / 8);
+		data.fd_flags = O_RDWR | O_CLOEXEC;
+		if (ioctl(heap_fd_, DMA_HEAP_IOCTL_ALLOC, &data) < 0) {
+			printf("%s: allocation of %llu bytes failed: %s\n", name_, data.len, strerror(errno));
+			return -1;
+		}
+		void *ptr = mmap(NULL, data.len, PROT_READ | PROT_WRITE, MAP_SHARED, data.fd, 0);
+		if (ptr == MAP_FAILED) {
+			printf("%s: mmap failed: %s\n", name_, strerror(errno));
+			close(data.fd);
+			return -1;
+		}
+		buf->drm_buf_fd = data.fd;
+		buf->drm_buf_handle = 0;
+		buf->drm_buf_ptr = ptr;
+		buf->drm_buf_size = data.len;
+		buf->drm_buf_pitch = width * bpp / 8;
+		return 0;
+	}
+	void release(struct drm_buf *buf) override
+	{
+		munmap(buf->drm_buf_ptr, buf->drm_buf_size);
+		close(buf->drm_buf_fd);
+	}
+
+    private:
+	const char *name_;
+	int heap_fd_ = -1;
+};
+
+class MallocAllocator : public DmaAllocator {
+    public:
+	const char *name() const override
+	{
+		return "malloc";
+	}
+	bool exports_fd() const override
+	{
+		return false;
+	}
+	int allocate(int width, int rows, int bpp, struct drm_buf *buf) override
+	{
+		size_t size = page_align((size_t)width * rows * bpp / 8);
+		void *ptr = NULL;
+		if (posix_memalign(&ptr, (size_t)sysconf(_SC_PAGESIZE), size) != 0) {
+			return -1;
+		}
+		buf->drm_buf_fd = -1;
+		buf->drm_buf_handle = 0;
+		buf->drm_buf_ptr = ptr;
+		buf->drm_buf_size = size;
+		buf->drm_buf_pitch = width * bpp / 8;
+		return 0;
+	}
+	void release(struct drm_buf *buf) override
+	{
+		free(buf->drm_buf_ptr);
+	}
+};
+
+static const char *const SYSTEM_HEAP_PATHS[] = { "/dev/dma_heap/system", NULL };
+static const char *const CMA_HEAP_PATHS[] = { "/dev/dma_heap/linux,cma", "/dev/dma_heap/reserved", "/dev/dma_heap/cma", NULL };
+
+static std::unique_ptr<DmaAllocator> create_backend(const std::string &name)
+{
+	if (name == "drm") {
+		std::unique_ptr<DrmDumbAllocator> drm(new DrmDumbAllocator());
+		return drm->ok() ? std::move(drm) : nullptr;
+	}
+	if (name == "heap-system") {
+		std::unique_ptr<DmaHeapAllocator> heap(new DmaHeapAllocator("heap-system", SYSTEM_HEAP_PATHS));
+		return heap->ok() ? std::move(heap) : nullptr;
+	}
+	if (name == "heap-cma") {
+		std::unique_ptr<DmaHeapAllocator> heap(new DmaHeapAllocator("heap-cma", CMA_HEAP_PATHS));
+		return heap->ok() ? std::move(heap) : nullptr;
+	}
+	if (name == "malloc") {
+		return std::unique_ptr<DmaAllocator>(new MallocAllocator());
+	}
+	return nullptr;
+}
+
+// A device node can open yet refuse allocations (no dumb buffer support, empty CMA pool)
+static bool can_allocate(DmaAllocator *allocator)
+{
+	struct drm_buf probe;
+	if (allocator->allocate(64, 64, 32, &probe) != 0) {
+		return false;
+	}
+	allocator->release(&probe);
+	return true;
+}
+
+std::unique_ptr<DmaAllocator> create_dma_allocator(const std::string &name)
+{
+	if (name != "auto") {
+		std::unique_ptr<DmaAllocator> allocator = create_backend(name);
+		if (!allocator) {
+			printf("ERROR: DMA allocator '%s' is unknown or unavailable\n", name.c_str());
+		}
+		return allocator;
+	}
+
+	static const char *const AUTO_ORDER[] = { "drm", "heap-system", "heap-cma", "malloc" };
+	for (const char *candidate : AUTO_ORDER) {
+		std::unique_ptr<DmaAllocator> allocator = create_backend(candidate);
+		if (allocator && can_allocate(allocator.get())) {
+			return allocator;
+		}
+		printf("DMA allocator '%s' unavailable, trying next\n", candidate);
+	}
+	return nullptr;
+}
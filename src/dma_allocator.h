@@ -0,0 +1,38 @@
+#ifndef __DMA_ALLOCATOR_H__
+#define __DMA_ALLOCATOR_H__
+
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+#include "config.h"
+
+// Where DMA buffers come from.
+//
+// Every backend fills the same struct drm_buf: virtual address, size and,
+// where the backend has one, a dma-buf fd that RGA and the NPU can import.
+// Backends:
+//   "drm"         DRM dumb buffers on /dev/dri/card0 (Rockchip BSP)
+//   "heap-system" /dev/dma_heap/system (mainline kernels, 5.6+)
+//   "heap-cma"    the CMA dma-heap, physically contiguous
+//   "malloc"      page-aligned heap memory, no fd
+//   "auto"        the first of the above that can allocate
+class DmaAllocator {
+    public:
+	virtual ~DmaAllocator() {}
+
+	virtual const char *name() const = 0;
+
+	// False for backends whose buffers carry no dma-buf fd (drm_buf_fd == -1)
+	virtual bool exports_fd() const = 0;
+
+	// width x rows at bpp bits per pixel; fills buf, including the row pitch
+	// the backend chose, and returns 0, or -1
+	virtual int allocate(int width, int rows, int bpp, struct drm_buf *buf) = 0;
+	virtual void release(struct drm_buf *buf) = 0;
+};
+
+// nullptr if the named backend is unknown or unavailable on this system
+std::unique_ptr<DmaAllocator> create_dma_allocator(const std::string &name);
+
+#endif
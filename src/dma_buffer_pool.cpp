@@ -0,0 +1,119 @@
+#include "dma_buffer_pool.h"
+
+#include <stdio.h>
+
+#include "rga_func.h"
+
+// Dumb buffers are described as width x rows x bpp; 4:2:0 formats are 8bpp with 1.5x the rows
+static void dumb_geometry(int width, int height, int format, int *rows, int *bpp)
+{
+	switch (format) {
+	case RK_FORMAT_RGBA_8888:
+		*rows = height;
+		*bpp = 32;
+		break;
+	case RK_FORMAT_YCbCr_420_SP:
+	case RK_FORMAT_YCrCb_420_SP:
+	case RK_FORMAT_YCbCr_420_P:
+		*rows = height * 3 / 2;
+		*bpp = 8;
+		break;
+	default: // RGB888 / BGR888
+		*rows = height;
+		*bpp = 24;
+		break;
+	}
+}
+
+DmaBufferPool::DmaBufferPool(std::unique_ptr<DmaAllocator> allocator, const std::string &name)
+	: allocator_(std::move(allocator)), name_(name)
+{
+}
+
+DmaBufferPool::~DmaBufferPool()
+{
+	// Every outstanding buffer holds a reference to the pool, so all are back by now
+	for (auto &it : buckets_) {
+		for (auto *buf : it.second.free) {
+			allocator_->release(buf);
+			delete buf;
+		}
+	}
+}
+
+struct drm_buf *DmaBufferPool::allocate(const Key &key)
+{
+	int rows, bpp;
+	dumb_geometry(key.width, key.height, key.format, &rows, &bpp);
+	struct drm_buf *buf = new drm_buf();
+	if (allocator_->allocate(key.width, rows, bpp, buf) != 0) {
+		printf("ERROR: %s pool (%s) failed to allocate %dx%d format %d\n", name_.c_str(), allocator_->name(), key.width,
+		       key.height, key.format);
+		delete buf;
+		return nullptr;
+	}
+	return buf;
+}
+
+std::shared_ptr<struct drm_buf> DmaBufferPool::acquire(int width, int height, int format)
+{
+	Key key = { width, height, format };
+	struct drm_buf *buf = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		Bucket &bucket = buckets_[key];
+		if (!bucket.free.empty()) {
+			buf = bucket.free.back();
+			bucket.free.pop_back();
+		} else {
+			buf = allocate(key);
+			if (!buf) {
+				return nullptr;
+			}
+			bucket.total++;
+			bucket.buf_size = buf->drm_buf_size;
+			report_locked();
+		}
+	}
+
+	auto self = shared_from_this();
+	return std::shared_ptr<struct drm_buf>(buf, [self, key](struct drm_buf *b) { self->release(key, b); });
+}
+
+void DmaBufferPool::release(const Key &key, struct drm_buf *buf)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	buckets_[key].free.push_back(buf);
+}
+
+DmaBufferPool::Stats DmaBufferPool::get_stats()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	Stats stats = { 0, 0, 0, 0 };
+	for (const auto &it : buckets_) {
+		int in_use = it.second.total - (int)it.second.free.size();
+		stats.buffers += it.second.total;
+		stats.in_use += in_use;
+		stats.bytes += it.second.total * it.second.buf_size;
+		stats.bytes_in_use += in_use * it.second.buf_size;
+	}
+	return stats;
+}
+
+void DmaBufferPool::report()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	report_locked();
+}
+
+void DmaBufferPool::report_locked()
+{
+	printf("DMA POOL %s (%s):", name_.c_str(), allocator_->name());
+	size_t bytes = 0;
+	for (const auto &it : buckets_) {
+		int in_use = it.second.total - (int)it.second.free.size();
+		printf(" %dx%d/fmt%d %d/%d in use", it.first.width, it.first.height, it.first.format, in_use, it.second.total);
+		bytes += it.second.total * it.second.buf_size;
+	}
+	printf(", %.1fMB total\n", bytes / (1024.0 * 1024.0));
+}
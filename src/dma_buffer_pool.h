@@ -0,0 +1,61 @@
+#ifndef __DMA_BUFFER_POOL_H__
+#define __DMA_BUFFER_POOL_H__
+
+#include <stddef.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "dma_allocator.h"
+
+// DMA buffers of exact size, keyed by (width, height, RK_FORMAT_*).
+//
+// acquire() hands out a shared_ptr; when the last stage holding the
+// buffer drops it, the buffer goes back to its bucket instead of being
+// freed. Buckets only grow when every buffer of that shape is still in
+// flight, so a pipeline gets exactly as many buffers as it keeps busy.
+class DmaBufferPool : public std::enable_shared_from_this<DmaBufferPool> {
+    public:
+	DmaBufferPool(std::unique_ptr<DmaAllocator> allocator, const std::string &name);
+	~DmaBufferPool();
+
+	// nullptr if the allocation fails
+	std::shared_ptr<struct drm_buf> acquire(int width, int height, int format);
+
+	struct Stats {
+		int buffers;
+		int in_use;
+		size_t bytes;
+		size_t bytes_in_use;
+	};
+	Stats get_stats();
+	void report();
+
+    private:
+	struct Key {
+		int width, height, format;
+		bool operator<(const Key &o) const
+		{
+			return width != o.width ? width < o.width : (height != o.height ? height < o.height : format < o.format);
+		}
+	};
+	struct Bucket {
+		std::vector<struct drm_buf *> free;
+		int total = 0;
+		size_t buf_size = 0;
+	};
+
+	std::unique_ptr<DmaAllocator> allocator_;
+	std::string name_;
+	std::mutex mutex_;
+	std::map<Key, Bucket> buckets_;
+
+	struct drm_buf *allocate(const Key &key);
+	void release(const Key &key, struct drm_buf *buf);
+	void report_locked();
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "dma_frame_alloc.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "rga_func.h"
+
+struct DmaFrame {
+	DmaFrameInfo info;
+	std::shared_ptr<struct drm_buf> buf;
+};
+
+// Identifies opaque_ref buffers made here; its address is the tag, the value is unused
+static const char dma_frame_tag = 0;
+
+// What opaque_ref carries: the frame's info, and a reference that keeps its pool buffer alive
+struct DmaFrameRef {
+	DmaFrameInfo info;
+	AVBufferRef *frame_buf;
+};
+
+static void release_dma_frame(void *opaque, uint8_t *data)
+{
+	delete (DmaFrame *)opaque;
+}
+
+static void release_dma_frame_ref(void *opaque, uint8_t *data)
+{
+	DmaFrameRef *ref = (DmaFrameRef *)data;
+	av_buffer_unref(&ref->frame_buf);
+	delete ref;
+}
+
+static int dma_get_buffer2(AVCodecContext *ctx, AVFrame *frame, int flags)
+{
+	DmaBufferPool *pool = (DmaBufferPool *)ctx->opaque;
+	bool planar = frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P;
+	bool semi_planar = frame->format == AV_PIX_FMT_NV12;
+	if (!pool || (!planar && !semi_planar)) {
+		return avcodec_default_get_buffer2(ctx, frame, flags);
+	}
+
+	// The decoder writes up to its aligned size, so planes are laid out for that, not the visible size
+	int width = frame->width;
+	int height = frame->height;
+	int linesize_align[AV_NUM_DATA_POINTERS];
+	avcodec_align_dimensions2(ctx, &width, &height, linesize_align);
+	// RGA needs 16-pixel strides; 64 keeps the half-width chroma rows SIMD-aligned as well
+	int stride = FFALIGN(width, 64);
+	height = FFALIGN(height, 2);
+	int rga_format = planar ? RK_FORMAT_YCbCr_420_P : RK_FORMAT_YCbCr_420_SP;
+
+	// Two spare rows: some decoders' SIMD reads run past the last line
+	std::shared_ptr<struct drm_buf> buf = pool->acquire(stride, height + 2, rga_format);
+	if (!buf || buf->drm_buf_fd < 0) {
+		return avcodec_default_get_buffer2(ctx, frame, flags);
+	}
+	// The allocator may have padded the rows further; planes follow the pitch it chose
+	stride = std::max(stride, buf->drm_buf_pitch);
+
+	DmaFrame *dma = new DmaFrame();
+	dma->info.fd = buf->drm_buf_fd;
+	dma->info.vstride = height;
+	dma->info.rga_format = rga_format;
+	dma->info.luma = (const uint8_t *)buf->drm_buf_ptr;
+	dma->buf = buf;
+
+	uint8_t *base = (uint8_t *)buf->drm_buf_ptr;
+	frame->buf[0] = av_buffer_create(base, (int)buf->drm_buf_size, release_dma_frame, dma, 0);
+	if (!frame->buf[0]) {
+		delete dma;
+		return AVERROR(ENOMEM);
+	}
+	// Tagged so dma_frame_info() can tell it from an opaque_ref set by anyone else
+	DmaFrameRef *ref = new DmaFrameRef();
+	ref->info = dma->info;
+	ref->frame_buf = av_buffer_ref(frame->buf[0]);
+	if (ref->frame_buf) {
+		frame->opaque_ref = av_buffer_create((uint8_t *)ref, sizeof(*ref), release_dma_frame_ref, (void *)&dma_frame_tag,
+						     AV_BUFFER_FLAG_READONLY);
+	}
+	if (!frame->opaque_ref) {
+		av_buffer_unref(&ref->frame_buf);
+		delete ref;
+		av_buffer_unref(&frame->buf[0]);
+		return AVERROR(ENOMEM);
+	}
+
+	frame->data[0] = base;
+	frame->linesize[0] = stride;
+	frame->data[1] = base + (size_t)stride * height;
+	if (planar) {
+		frame->linesize[1] = stride / 2;
+		frame->data[2] = frame->data[1] + (size_t)(stride / 2) * (height / 2);
+		frame->linesize[2] = stride / 2;
+	} else {
+		frame->linesize[1] = stride;
+	}
+	frame->extended_data = frame->data;
+	return 0;
+}
+
+bool install_dma_get_buffer(AVCodecContext *ctx, DmaBufferPool *pool)
+{
+	if (!ctx->codec || !(ctx->codec->capabilities & AV_CODEC_CAP_DR1)) {
+		return false;
+	}
+	ctx->opaque = pool;
+	ctx->get_buffer2 = dma_get_buffer2;
+	return true;
+}
+
+const DmaFrameInfo *dma_frame_info(const AVFrame *frame)
+{
+	if (!frame->opaque_ref || av_buffer_get_opaque(frame->opaque_ref) != &dma_frame_tag) {
+		return nullptr;
+	}
+	return &((const DmaFrameRef *)frame->opaque_ref->data)->info;
+}
@@ -0,0 +1,33 @@
+#ifndef __DMA_FRAME_ALLOC_H__
+#define __DMA_FRAME_ALLOC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavcodec/avcodec.h>
+#ifdef __cplusplus
+}
+#endif
+
+#include "dma_buffer_pool.h"
+
+// Where a software-decoded frame lives when its planes came from the pool
+struct DmaFrameInfo {
+	int fd;
+	int vstride; // luma rows before the chroma plane starts
+	int rga_format; // RK_FORMAT_YCbCr_420_P or RK_FORMAT_YCbCr_420_SP
+	const uint8_t *luma; // where data[0] points before any cropping
+};
+
+// Make a software decoder allocate YUV420P/YUVJ420P/NV12 frames in pool
+// buffers, laid out the way RGA reads them, so they can be scaled and
+// converted by fd like DRM PRIME frames. Other formats, and allocations
+// the pool cannot serve, use the default allocator. Takes ctx->opaque;
+// the pool must outlive the codec context. Returns false if the decoder
+// cannot use a custom allocator.
+bool install_dma_get_buffer(AVCodecContext *ctx, DmaBufferPool *pool);
+
+// nullptr for frames not allocated by the pool
+const DmaFrameInfo *dma_frame_info(const AVFrame *frame);
+
+#endif
@@ -0,0 +1,112 @@
+#include "dmabuf_map.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "config.h"
+
+// Older BSP kernel headers may lack the sync uapi (added in 4.6)
+#if defined(__has_include)
+#if __has_include(<linux/dma-buf.h>)
+#include <linux/dma-buf.h>
+#endif
+#endif
+#ifndef DMA_BUF_IOCTL_SYNC
+struct dma_buf_sync {
+	unsigned long long flags;
+};
+#define DMA_BUF_SYNC_READ (1 << 0)
+#define DMA_BUF_SYNC_WRITE (2 << 0)
+#define DMA_BUF_SYNC_RW (DMA_BUF_SYNC_READ | DMA_BUF_SYNC_WRITE)
+#define DMA_BUF_SYNC_START (0 << 2)
+#define DMA_BUF_SYNC_END (1 << 2)
+#define DMA_BUF_BASE 'b'
+#define DMA_BUF_IOCTL_SYNC _IOW(DMA_BUF_BASE, 0, struct dma_buf_sync)
+#endif
+
+DmaBufMapCache::~DmaBufMapCache()
+{
+	clear();
+}
+
+const uint8_t *DmaBufMapCache::map(int fd, size_t size)
+{
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		return nullptr;
+	}
+
+	for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+		if (it->ino == st.st_ino && it->fd == fd && it->size == size) {
+			entries_.splice(entries_.begin(), entries_, it);
+			hits_++;
+			return (const uint8_t *)it->ptr;
+		}
+	}
+
+	void *ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (ptr == MAP_FAILED) {
+		printf("Error: Failed to map dma-buf fd=%d: %s\n", fd, strerror(errno));
+		return nullptr;
+	}
+	misses_++;
+	entries_.push_front(Entry{ st.st_ino, fd, size, ptr });
+
+	// More surfaces than the decoder pool holds means they are being reallocated
+	if ((int)entries_.size() > DMABUF_MAP_CACHE_MAX) {
+		munmap(entries_.back().ptr, entries_.back().size);
+		entries_.pop_back();
+	}
+	return (const uint8_t *)ptr;
+}
+
+void DmaBufMapCache::clear()
+{
+	for (auto &entry : entries_) {
+		munmap(entry.ptr, entry.size);
+	}
+	entries_.clear();
+}
+
+DmaBufMapCache::Stats DmaBufMapCache::get_stats() const
+{
+	Stats stats = { hits_, misses_, (int)entries_.size() };
+	return stats;
+}
+
+static unsigned long long sync_flags(DmaBufCpuAccess::Mode mode)
+{
+	switch (mode) {
+	case DmaBufCpuAccess::READ:
+		return DMA_BUF_SYNC_READ;
+	case DmaBufCpuAccess::WRITE:
+		return DMA_BUF_SYNC_WRITE;
+	default:
+		return DMA_BUF_SYNC_RW;
+	}
+}
+
+DmaBufCpuAccess::DmaBufCpuAccess(int fd, Mode mode) : fd_(fd), flags_(sync_flags(mode))
+{
+	if (fd_ < 0) {
+		return;
+	}
+	struct dma_buf_sync sync = { flags_ | DMA_BUF_SYNC_START };
+	if (ioctl(fd_, DMA_BUF_IOCTL_SYNC, &sync) != 0) {
+		// Exporters without begin_cpu_access still work, just without coherency guarantees
+		fd_ = -1;
+	}
+}
+
+DmaBufCpuAccess::~DmaBufCpuAccess()
+{
+	if (fd_ < 0) {
+		return;
+	}
+	struct dma_buf_sync sync = { flags_ | DMA_BUF_SYNC_END };
+	ioctl(fd_, DMA_BUF_IOCTL_SYNC, &sync);
+}
@@ -0,0 +1,64 @@
+#ifndef __DMABUF_MAP_H__
+#define __DMABUF_MAP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <list>
+
+// CPU mappings of decoder surfaces, made once per dma-buf.
+//
+// The decoder cycles through a small, fixed set of surfaces, so mapping
+// each one on first sight and keeping it turns a per-frame mmap/munmap
+// into a lookup. Entries are keyed by the dma-buf inode (unique per
+// buffer) together with fd and size, so a recycled fd number pointing at
+// a different buffer is never served a stale mapping. A mapping holds a
+// reference to its buffer: clear() when the decoder goes away.
+class DmaBufMapCache {
+    public:
+	~DmaBufMapCache();
+
+	// Read-only mapping of fd, or nullptr
+	const uint8_t *map(int fd, size_t size);
+	void clear();
+
+	struct Stats {
+		long long hits;
+		long long misses;
+		int entries;
+	};
+	Stats get_stats() const;
+
+    private:
+	struct Entry {
+		ino_t ino;
+		int fd;
+		size_t size;
+		void *ptr;
+	};
+	std::list<Entry> entries_; // most recently used first
+	long long hits_ = 0;
+	long long misses_ = 0;
+};
+
+// CPU access bracket for a dma-buf (DMA_BUF_IOCTL_SYNC start/end).
+//
+// Cached mappings are only coherent with RGA, the decoder and the NPU
+// when CPU access is announced: start invalidates stale cache lines before
+// reading, end writes back what the CPU wrote. No-op for fd < 0.
+class DmaBufCpuAccess {
+    public:
+	enum Mode { READ = 1, WRITE = 2, READ_WRITE = 3 };
+
+	DmaBufCpuAccess(int fd, Mode mode);
+	~DmaBufCpuAccess();
+
+    private:
+	int fd_;
+	unsigned long long flags_;
+
+	DmaBufCpuAccess(const DmaBufCpuAccess &) = delete;
+	DmaBufCpuAccess &operator=(const DmaBufCpuAccess &) = delete;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "ffmpeg.h"
 #include <thread>
+#include <mutex>
 #include <chrono>
 #include <sys/mman.h>
 #include <errno.h>
@@ -7,59 +8,64 @@
 #include <unistd.h>
 #include <dlfcn.h>
 
-int FFmpegStreamChannel::init_rga_drm()
+// RGA strides are in pixels; -1 when the allocator's pitch is not a whole number of BGR888 pixels
+static int bgr888_stride(const struct drm_buf *buf)
 {
-	printf("=== Initializing DRM and RGA Hardware Acceleration ===\n");
-
-	/* init drm */
-	memset(&drm_ctx, 0, sizeof(drm_context));
-	int drm_fd = rknn_drm_init(&drm_ctx);
+	return buf->drm_buf_pitch % 3 == 0 ? buf->drm_buf_pitch / 3 : -1;
+}
 
-	if (drm_fd < 0) {
-		printf("ERROR: DRM initialization failed (fd=%d), forcing software-only mode\n", drm_fd);
+int FFmpegStreamChannel::init_rga_drm()
+{
+	printf("=== Initializing DMA buffers and RGA Hardware Acceleration ===\n");
+
+	/* init dma buffers; the backend is chosen at start-up so the same build runs on BSP and mainline kernels */
+	const char *requested = getenv("DMA_ALLOCATOR");
+	std::string allocator_name = requested ? requested : DMA_ALLOCATOR_DEFAULT;
+	std::unique_ptr<DmaAllocator> allocator = create_dma_allocator(allocator_name);
+	if (!allocator) {
+		printf("ERROR: No DMA allocator available (requested '%s'), forcing software-only mode\n", allocator_name.c_str());
 		use_software_only = true;
 		return -1;
 	}
+	bool exports_fd = allocator->exports_fd();
+	std::string channel_allocator_name = allocator->name();
+	printf("DMA allocator: %s%s\n", allocator->name(), exports_fd ? "" : " (no dma-buf fds)");
 
-	printf("DRM initialization successful (fd=%d)\n", drm_fd);
-
-	/* drm mem1 - for RKNN input (RGB888) */
-	printf("Allocating DRM buffer 1 for RKNN input...\n");
-	drm_buf_for_rga1.drm_buf_ptr = rknn_drm_buf_alloc(&drm_ctx, drm_fd, 2560, 1440,
-							  4 * 8, // 4 channel x 8bit
-							  &drm_buf_for_rga1.drm_buf_fd, &drm_buf_for_rga1.drm_buf_handle, &drm_buf_for_rga1.drm_buf_size);
+	// Model input and display buffers come from the pool at their exact sizes, on first use
+	buffer_pool_ = std::make_shared<DmaBufferPool>(std::move(allocator), "channel");
 
-	if (!drm_buf_for_rga1.drm_buf_ptr || drm_buf_for_rga1.drm_buf_fd < 0) {
-		printf("ERROR: Failed to allocate DRM buffer 1 (ptr=%p, fd=%d)\n",
-			   drm_buf_for_rga1.drm_buf_ptr, drm_buf_for_rga1.drm_buf_fd);
+	// RGA imports buffers by fd; without fds the CPU converts into the same buffers
+	if (!exports_fd) {
+		printf("RGA needs dma-buf fds, using software conversion\n");
 		use_software_only = true;
-		return -1;
+		return 0;
 	}
 
-	printf("DRM buffer 1 allocated: fd=%d, size=%zu bytes\n",
-		   drm_buf_for_rga1.drm_buf_fd, drm_buf_for_rga1.drm_buf_size);
-
-	/* drm mem2 - for display output (BGR888) */
-	printf("Allocating DRM buffer 2 for display output...\n");
-	drm_buf_for_rga2.drm_buf_ptr = rknn_drm_buf_alloc(&drm_ctx, drm_fd, 2560, 1440,
-							  4 * 8, // 4 channel x 8bit
-							  &drm_buf_for_rga2.drm_buf_fd, &drm_buf_for_rga2.drm_buf_handle, &drm_buf_for_rga2.drm_buf_size);
-
-	if (!drm_buf_for_rga2.drm_buf_ptr || drm_buf_for_rga2.drm_buf_fd < 0) {
-		printf("ERROR: Failed to allocate DRM buffer 2 (ptr=%p, fd=%d)\n",
-			   drm_buf_for_rga2.drm_buf_ptr, drm_buf_for_rga2.drm_buf_fd);
-		use_software_only = true;
-		return -1;
+	// Software decoders read their reference frames back, which is slow from the uncached
+	// memory "drm" dumb buffers are on the BSP; decoded frames get a cached backend if there is one
+	surface_pool_ = buffer_pool_;
+	std::string surface_allocator_name = SW_DECODE_DMA_ALLOCATOR;
+	if (!surface_allocator_name.empty() && surface_allocator_name != channel_allocator_name) {
+		std::unique_ptr<DmaAllocator> surface_allocator = create_dma_allocator(surface_allocator_name);
+		if (surface_allocator && surface_allocator->exports_fd()) {
+			printf("Decoder surface allocator: %s\n", surface_allocator->name());
+			surface_pool_ = std::make_shared<DmaBufferPool>(std::move(surface_allocator), "decoder");
+		} else {
+			printf("Decoder surfaces share the channel allocator\n");
+		}
 	}
 
-	printf("DRM buffer 2 allocated: fd=%d, size=%zu bytes\n",
-		   drm_buf_for_rga2.drm_buf_fd, drm_buf_for_rga2.drm_buf_size);
-
 	/* init rga only if hardware acceleration is enabled */
 	memset(&rga_ctx, 0, sizeof(rga_context));
 	if (ENABLE_RGA_HARDWARE) {
 		printf("Initializing RGA hardware acceleration...\n");
-		int rga_ret = rknn_rga_init(&rga_ctx);
+		int rga_ret;
+		{
+			// Channels initialise concurrently; librga's global init is not documented as thread-safe
+			static std::mutex rga_init_mutex;
+			std::lock_guard<std::mutex> lock(rga_init_mutex);
+			rga_ret = rknn_rga_init(&rga_ctx);
+		}
 		if (rga_ret != 0) {
 			printf("ERROR: RGA initialization failed (ret=%d), forcing software-only mode\n", rga_ret);
 			use_software_only = true;
@@ -112,14 +118,11 @@ void FFmpegStreamChannel::bind_cv_mat_to_gl_texture(cv::Mat &image, GLuint &imag
 		     image.ptr()); // The actual image data itself
 }
 
-int FFmpegStreamChannel::init_rknn2()
+int FFmpegStreamChannel::init_rknn2(const ModelConfig &model)
 {
-	printf("Loading mode...\n");
-	int model_data_size = 0;
-	unsigned char *model_data = load_model(MODEL_PATH, &model_data_size);
-	int ret = rknn_init(&rknn_ctx, model_data, model_data_size, 0, NULL);
+	printf("Loading mode %s...\n", model.model_path.c_str());
+	int ret = HardwareRuntime::instance().create_context(model.model_path, &rknn_ctx);
 	if (ret < 0) {
-		printf("rknn_init error ret=%d\n", ret);
 		return -1;
 	}
 
@@ -151,26 +154,60 @@ int FFmpegStreamChannel::init_rknn2()
 	}
 
 	output_attrs = (rknn_tensor_attr *)malloc(io_num.n_output * sizeof(rknn_tensor_attr));
-	memset(output_attrs, 0, sizeof(output_attrs));
+	memset(output_attrs, 0, io_num.n_output * sizeof(rknn_tensor_attr));
 	for (int i = 0; i < io_num.n_output; i++) {
 		output_attrs[i].index = i;
 		ret = rknn_query(rknn_ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
 		dump_tensor_attr(&(output_attrs[i]));
 	}
 
+	if (output_workspace_.init(output_attrs, io_num.n_output) != 0) {
+		return -1;
+	}
+
+	// RKNN2 reports dims outermost first: NCHW = [n, c, h, w], NHWC = [n, h, w, c]
 	if (input_attrs[0].fmt == RKNN_TENSOR_NCHW) {
 		printf("model is NCHW input fmt\n");
 		rknn_input_channel = input_attrs[0].dims[1];
-		rknn_input_width = input_attrs[0].dims[2];
-		rknn_input_height = input_attrs[0].dims[3];
+		rknn_input_height = input_attrs[0].dims[2];
+		rknn_input_width = input_attrs[0].dims[3];
 	} else {
 		printf("model is NHWC input fmt\n");
-		rknn_input_width = input_attrs[0].dims[1];
-		rknn_input_height = input_attrs[0].dims[2];
+		rknn_input_height = input_attrs[0].dims[1];
+		rknn_input_width = input_attrs[0].dims[2];
 		rknn_input_channel = input_attrs[0].dims[3];
 	}
 	printf("model input height=%d, width=%d, channel=%d\n", rknn_input_height, rknn_input_width, rknn_input_channel);
 
+	// Post-processing derives its grids from the input shape; catch models where that does not hold
+	const int strides[3] = { 8, 16, 32 };
+	int outputs_per_level = std::max(1, (int)io_num.n_output / 3);
+	for (int l = 0; l < 3 && l * outputs_per_level < (int)io_num.n_output; l++) {
+		int i = l * outputs_per_level;
+		int grid_h = output_attrs[i].dims[2];
+		int grid_w = output_attrs[i].dims[3];
+		if (grid_h * strides[l] != rknn_input_height || grid_w * strides[l] != rknn_input_width) {
+			printf("WARNING: output %d grid %dx%d does not match input %dx%d at stride %d\n", i, grid_w, grid_h,
+			       rknn_input_width, rknn_input_height, strides[l]);
+		}
+	}
+
+	// The model's custom string may name its head; otherwise the decoder is chosen from the output layout
+	rknn_custom_string custom_string;
+	memset(&custom_string, 0, sizeof(custom_string));
+	ret = rknn_query(rknn_ctx, RKNN_QUERY_CUSTOM_STRING, &custom_string, sizeof(custom_string));
+	if (ret == 0 && custom_string.string[0]) {
+		printf("model custom string: %s\n", custom_string.string);
+	}
+	decoder_ = DetectionDecoder::create(model.decoder, ret == 0 ? custom_string.string : nullptr, output_attrs, io_num.n_output,
+					    model.labels_path.c_str());
+	if (!decoder_) {
+		return -1;
+	}
+	if (apply_class_filter(model.classes) != 0) {
+		return -1;
+	}
+
 	// Update member variables to prevent corruption
 	rknn_width_ = rknn_input_width;
 	rknn_height_ = rknn_input_height;
@@ -184,15 +221,75 @@ int FFmpegStreamChannel::init_rknn2()
 	inputs[0].fmt = RKNN_TENSOR_NHWC;
 	inputs[0].pass_through = 0;
 
+	if (MODEL_WARMUP) {
+		warm_up_model();
+	}
 	return 0;
 }
 
+// Resolve the comma-separated labels against the model's classes and restrict the decoder to them
+int FFmpegStreamChannel::apply_class_filter(const std::string &classes)
+{
+	std::vector<int> ids;
+	size_t start = 0;
+	while (start < classes.size()) {
+		size_t end = classes.find(',', start);
+		if (end == std::string::npos) {
+			end = classes.size();
+		}
+		std::string label = classes.substr(start, end - start);
+		start = end + 1;
+		if (label.empty()) {
+			continue;
+		}
+		int id = decoder_->class_id(label.c_str());
+		if (id < 0) {
+			printf("ERROR: model has no class '%s'\n", label.c_str());
+			return -1;
+		}
+		ids.push_back(id);
+	}
+	if (decoder_->set_class_filter(ids) != 0) {
+		return -1;
+	}
+	if (ids.empty()) {
+		printf("Detecting all %d classes\n", decoder_->num_classes());
+	} else {
+		printf("Detecting %zu of %d classes: %s\n", ids.size(), decoder_->num_classes(), classes.c_str());
+	}
+	return 0;
+}
+
+// The first rknn_run on a context pays for lazy allocations; do it before the first real frame
+void FFmpegStreamChannel::warm_up_model()
+{
+	long long start_us = current_timestamp();
+	std::vector<uint8_t> blank(inputs[0].size, 0);
+	rknn_input input = inputs[0];
+	input.buf = blank.data();
+	if (rknn_inputs_set(rknn_ctx, 1, &input) < 0 || rknn_run(rknn_ctx, NULL) < 0) {
+		printf("WARNING: model warm-up run failed\n");
+		return;
+	}
+	output_workspace_.fetch(rknn_ctx);
+	printf("Model warm-up took %.1fms\n", (current_timestamp() - start_us) / 1000.0);
+}
+
 // Hardware acceleration helper functions
-int FFmpegStreamChannel::process_frame_hardware(int fd, int src_w, int src_h, int src_pitch)
+int FFmpegStreamChannel::process_frame_hardware(const FrameDesc &desc, ModelInputSlot *model_input, bool need_display_output)
 {
+	int src_w = desc.width;
+	int src_h = desc.height;
+	int src_pitch = desc.pitch;
 	printf("DEBUG: Hardware processing %dx%d (pitch=%d) -> RKNN: %dx%d, Display: %dx%d\n",
 		   src_w, src_h, src_pitch, rknn_width_, rknn_height_, display_width_, display_height_);
 
+	// The layout comes from the decoder; frames RGA cannot read go to the software path
+	if (desc.fd < 0 || desc.rga_format < 0) {
+		printf("DEBUG: Frame layout not readable by RGA (fd=%d, format=%d)\n", desc.fd, desc.rga_format);
+		return -1;
+	}
+
 	// Validate pitch - should be >= width for proper stride handling
 	if (src_pitch < src_w) {
 		printf("WARNING: Invalid pitch %d < width %d, using width as pitch\n", src_pitch, src_w);
@@ -210,105 +307,44 @@ int FFmpegStreamChannel::process_frame_hardware(int fd, int src_w, int src_h, in
 		src_w = aligned_src_w;
 		src_h = aligned_src_h;
 	}
+	// RGA sees the whole allocated surface; the visible src_w x src_h is cropped out of it
+	int surface_h = std::max(desc.vstride, src_h);
 
-	// Try different YUV formats for RGA processing
-	// RKMPP typically outputs NV12 (YUV420SP), but format detection might fail
-	const struct {
-		int rga_format;
-		const char* name;
-	} yuv_formats[] = {
-		{RK_FORMAT_YCbCr_420_SP, "NV12/YUV420SP"},
-		{RK_FORMAT_YCbCr_420_P, "YUV420P"},
-		{RK_FORMAT_YCrCb_420_SP, "NV21"}
-	};
-
-	int ret1 = -1, ret2 = -1;
-	bool success = false;
-
-	// Try each format until one works, testing both RGB and BGR output formats
-	for (int i = 0; i < 3 && !success; i++) {
-		// Test both BGR and RGB formats to find the correct color ordering
-		const struct {
-			int rga_format;
-			const char* name;
-		} color_formats[] = {
-			{RK_FORMAT_BGR_888, "BGR888"},
-			{RK_FORMAT_RGB_888, "RGB888"}
-		};
-
-		for (int color_fmt = 0; color_fmt < 2 && !success; color_fmt++) {
-			printf("DEBUG: Trying RGA format %s -> %s for RKNN conversion (stride-aware)\n",
-				   yuv_formats[i].name, color_formats[color_fmt].name);
-
-			ret1 = rknn_img_resize_phy_to_phy_stride(&rga_ctx,
-				fd, src_w, src_h, src_pitch, yuv_formats[i].rga_format,
-				drm_buf_for_rga1.drm_buf_fd, rknn_width_, rknn_height_, color_formats[color_fmt].rga_format);
-
-			if (ret1 == 0) {
-				printf("DEBUG: RGA RKNN conversion successful with %s -> %s format (stride=%d)\n",
-					   yuv_formats[i].name, color_formats[color_fmt].name, src_pitch);
-
-				// Try display conversion with BGR format (OpenCV expects BGR)
-				printf("DEBUG: Trying RGA format %s -> BGR888 for display conversion (stride-aware)\n", yuv_formats[i].name);
-				ret2 = rknn_img_resize_phy_to_phy_stride(&rga_ctx,
-					fd, src_w, src_h, src_pitch, yuv_formats[i].rga_format,
-					drm_buf_for_rga2.drm_buf_fd, display_width_, display_height_, RK_FORMAT_BGR_888);
-
-				if (ret2 == 0) {
-					printf("DEBUG: RGA display conversion successful with %s -> BGR888 format (stride=%d)\n",
-						   yuv_formats[i].name, src_pitch);
-
-					// Store the successful format for future reference
-					printf("SUCCESS: Using YUV format %s with RKNN format %s and Display format BGR888\n",
-						   yuv_formats[i].name, color_formats[color_fmt].name);
-					success = true;
-					break;
-				} else {
-					printf("DEBUG: RGA display conversion failed with %s -> BGR888 format (ret=%d, stride=%d)\n",
-						   yuv_formats[i].name, ret2, src_pitch);
-				}
-			} else {
-				printf("DEBUG: RGA RKNN conversion failed with %s -> %s format (ret=%d, stride=%d)\n",
-					   yuv_formats[i].name, color_formats[color_fmt].name, ret1, src_pitch);
-			}
-		}
-	}
+	// The stream's matrix and range, not the driver default, decide the YUV -> RGB conversion
+	rga_ctx.color_space_mode = rga_color_space_mode(desc);
 
-	if (!success) {
-		printf("ERROR: All RGA format attempts failed (stride=%d) - RKNN ret=%d, Display ret=%d\n", src_pitch, ret1, ret2);
+	int model_stride = model_input ? bgr888_stride(model_input->buf) : 0;
+	int display_stride = need_display_output ? bgr888_stride(display_buf_.get()) : 0;
+	if (model_stride < 0 || display_stride < 0) {
+		printf("DEBUG: Destination pitch not expressible as an RGA stride\n");
 		return -1;
 	}
 
-	// Enhanced color debugging: Sample multiple pixels to verify color conversion
-	if (drm_buf_for_rga2.drm_buf_ptr && drm_buf_for_rga1.drm_buf_ptr) {
-		// Debug display buffer (BGR format for OpenCV)
-		uint8_t* display_data = (uint8_t*)drm_buf_for_rga2.drm_buf_ptr;
-		int center_x = display_width_ / 2;
-		int center_y = display_height_ / 2;
-		int center_idx = (center_y * display_width_ + center_x) * 3;
-
-		printf("DEBUG: Display buffer (BGR) center pixel: B=%d, G=%d, R=%d\n",
-			   display_data[center_idx], display_data[center_idx + 1], display_data[center_idx + 2]);
-
-		// Debug RKNN buffer (format depends on what was successful)
-		uint8_t* rknn_data = (uint8_t*)drm_buf_for_rga1.drm_buf_ptr;
-		int rknn_center_x = rknn_width_ / 2;
-		int rknn_center_y = rknn_height_ / 2;
-		int rknn_center_idx = (rknn_center_y * rknn_width_ + rknn_center_x) * 3;
-
-		printf("DEBUG: RKNN buffer center pixel: Ch0=%d, Ch1=%d, Ch2=%d\n",
-			   rknn_data[rknn_center_idx], rknn_data[rknn_center_idx + 1], rknn_data[rknn_center_idx + 2]);
-
-		// Sample corner pixels to verify consistency
-		int corner_idx = 0; // Top-left corner
-		printf("DEBUG: Display corner (0,0) BGR: B=%d, G=%d, R=%d\n",
-			   display_data[corner_idx], display_data[corner_idx + 1], display_data[corner_idx + 2]);
-
-		// Check for obvious color swapping patterns
-		bool likely_rgb_in_bgr = (display_data[center_idx] > display_data[center_idx + 2]) &&
-								 (display_data[center_idx + 2] > display_data[center_idx + 1]);
-		if (likely_rgb_in_bgr) {
-			printf("WARNING: Color channels may be swapped - Blue > Red > Green suggests RGB data in BGR buffer\n");
+	// Frames that only feed the tracker overlay skip the model input blit
+	if (model_input) {
+		const BOX_RECT &crop = model_input->crop;
+		const BOX_RECT &dst = model_input->dst;
+		int ret = rknn_img_crop_resize_phy_to_phy_stride(&rga_ctx,
+			desc.fd, src_w, surface_h, src_pitch, desc.rga_format,
+			crop.left, crop.top, crop.right - crop.left, crop.bottom - crop.top,
+			model_input->buf->drm_buf_fd, rknn_width_, rknn_height_, model_stride,
+			dst.left, dst.top, dst.right - dst.left, dst.bottom - dst.top, RK_FORMAT_BGR_888);
+		if (ret != 0) {
+			printf("ERROR: RGA RKNN conversion failed (ret=%d, stride=%d)\n", ret, src_pitch);
+			return -1;
+		}
+		update_model_transform(model_input, src_w, src_h);
+	}
+
+	if (need_display_output) {
+		int ret = rknn_img_crop_resize_phy_to_phy_stride(&rga_ctx,
+			desc.fd, src_w, surface_h, src_pitch, desc.rga_format,
+			0, 0, src_w, src_h,
+			display_buf_->drm_buf_fd, display_width_, display_height_, display_stride,
+			0, 0, display_width_, display_height_, RK_FORMAT_BGR_888);
+		if (ret != 0) {
+			printf("ERROR: RGA display conversion failed (ret=%d, stride=%d)\n", ret, src_pitch);
+			return -1;
 		}
 	}
 
@@ -316,789 +352,700 @@ int FFmpegStreamChannel::process_frame_hardware(int fd, int src_w, int src_h, in
 	return 0;
 }
 
-int FFmpegStreamChannel::process_frame_software_fallback(AVFrame* frame, int src_w, int src_h, int src_pitch)
+int FFmpegStreamChannel::process_frame_software_fallback(AVFrame *frame, const FrameDesc &desc, ModelInputSlot *model_input,
+							 bool need_display_output)
 {
+	int src_w = desc.width;
+	int src_h = desc.height;
 	printf("DEBUG: Software fallback processing %dx%d (pitch=%d) -> RKNN: %dx%d, Display: %dx%d\n",
-		   src_w, src_h, src_pitch, rknn_width_, rknn_height_, display_width_, display_height_);
+		   src_w, src_h, desc.pitch, rknn_width_, rknn_height_, display_width_, display_height_);
 
 	if (!frame || !frame->data[0]) {
 		printf("Error: Invalid frame data for software processing\n");
 		return -1;
 	}
 
-	// Prepare YUV data buffer
-	static std::vector<uint8_t> yuv_buffer;
-	uint8_t* yuv_data = nullptr;
-	bool need_unmap = false;
+	// Describe the planes where the decoder left them; nothing is copied before conversion
+	FramePlanes planes;
+	std::unique_ptr<DmaBufCpuAccess> source_access;
 
 	if (frame->format == AV_PIX_FMT_DRM_PRIME) {
-		// Handle DRM PRIME frames
+		// Handle DRM PRIME frames: surfaces are mapped once and reused, reads are bracketed for coherency
 		const AVDRMFrameDescriptor *av_drm_frame = reinterpret_cast<const AVDRMFrameDescriptor *>(frame->data[0]);
-		int fd = av_drm_frame->objects[0].fd;
 
-		void* mapped_ptr = mmap(NULL, av_drm_frame->objects[0].size, PROT_READ, MAP_SHARED, fd, 0);
-		if (mapped_ptr != MAP_FAILED) {
-			yuv_data = (uint8_t*)mapped_ptr;
-			need_unmap = true;
-			printf("DEBUG: Successfully mapped DRM buffer, size=%zu\n", av_drm_frame->objects[0].size);
-		} else {
-			printf("Error: Failed to map DRM buffer: %s\n", strerror(errno));
+		const uint8_t *base = surface_maps_.map(desc.fd, av_drm_frame->objects[0].size);
+		if (!base || frame_planes_from_drm(av_drm_frame, base, src_w, src_h, desc.vstride, &planes) != 0) {
 			return -1;
 		}
-	} else if (frame->format == AV_PIX_FMT_YUV420P) {
-		// Handle YUV420P frames - reconstruct planar data
-		int y_size = src_w * src_h;
-		int uv_size = (src_w / 2) * (src_h / 2);
-		size_t total_size = y_size + 2 * uv_size;
-
-		yuv_buffer.resize(total_size);
-
-		// Copy Y plane
-		for (int row = 0; row < src_h; ++row) {
-			memcpy(yuv_buffer.data() + row * src_w,
-				   frame->data[0] + row * frame->linesize[0], src_w);
-		}
-
-		// Copy U plane
-		uint8_t* u_dest = yuv_buffer.data() + y_size;
-		for (int row = 0; row < src_h/2; ++row) {
-			memcpy(u_dest + row * (src_w/2),
-				   frame->data[1] + row * frame->linesize[1], src_w/2);
-		}
-
-		// Copy V plane
-		uint8_t* v_dest = yuv_buffer.data() + y_size + uv_size;
-		for (int row = 0; row < src_h/2; ++row) {
-			memcpy(v_dest + row * (src_w/2),
-				   frame->data[2] + row * frame->linesize[2], src_w/2);
-		}
-
-		yuv_data = yuv_buffer.data();
-	} else {
-		printf("Error: Unsupported frame format for software processing: %d\n", frame->format);
+		source_access.reset(new DmaBufCpuAccess(desc.fd, DmaBufCpuAccess::READ));
+	} else if (frame_planes_from_avframe(frame, src_w, src_h, &planes) != 0) {
 		return -1;
 	}
+	const char *format_name = frame->format == AV_PIX_FMT_DRM_PRIME ? "DRM_PRIME" : av_get_pix_fmt_name((AVPixelFormat)frame->format);
 
-	if (!yuv_data) {
-		printf("Error: No YUV data available for software processing\n");
-		return -1;
-	}
-
-	// Determine YUV format based on frame type
-	bool is_nv12_format = (frame->format == AV_PIX_FMT_DRM_PRIME);
-
-	// Validate pitch - should be >= width for proper stride handling
-	if (src_pitch < src_w) {
-		printf("WARNING: Invalid pitch %d < width %d, using width as pitch\n", src_pitch, src_w);
-		src_pitch = src_w;
+	if (desc.matrix != color_tables_.matrix || desc.full_range != color_tables_.full_range) {
+		printf("Software YUV conversion: %s %s range\n", yuv_matrix_name(desc.matrix), desc.full_range ? "full" : "limited");
+		color_tables_.configure(desc);
 	}
 
 	// Process for RKNN (YUV -> BGR) - RKNN models typically expect BGR input
-	printf("DEBUG: Software RKNN conversion: %s(%dx%d, stride=%d) -> BGR888(%dx%d)\n",
-		   is_nv12_format ? "NV12" : "YUV420P", src_w, src_h, src_pitch, rknn_width_, rknn_height_);
-	if (is_nv12_format) {
-		nv12_to_bgr888_stride_rknn(yuv_data, (uint8_t*)drm_buf_for_rga1.drm_buf_ptr, src_w, src_h, src_pitch);
-	} else {
-		yuv420p_to_bgr888_stride_rknn(yuv_data, (uint8_t*)drm_buf_for_rga1.drm_buf_ptr, src_w, src_h, src_pitch);
+	if (model_input) {
+		printf("DEBUG: Software RKNN conversion: %s(%dx%d, stride=%d) -> BGR888(%dx%d)\n",
+			   format_name, src_w, src_h, planes.y_stride, rknn_width_, rknn_height_);
+		DmaBufCpuAccess model_access(model_input->buf->drm_buf_fd, DmaBufCpuAccess::WRITE);
+		frame_planes_to_bgr888(planes, color_tables_, model_input->crop, (uint8_t *)model_input->buf->drm_buf_ptr,
+				       model_input->buf->drm_buf_pitch, model_input->dst);
+		update_model_transform(model_input, src_w, src_h);
 	}
 
 	// Process for display (YUV -> BGR)
-	printf("DEBUG: Software Display conversion: %s(%dx%d, stride=%d) -> BGR888(%dx%d)\n",
-		   is_nv12_format ? "NV12" : "YUV420P", src_w, src_h, src_pitch, display_width_, display_height_);
-	if (is_nv12_format) {
-		nv12_to_bgr888_stride(yuv_data, (uint8_t*)drm_buf_for_rga2.drm_buf_ptr, src_w, src_h, src_pitch);
-	} else {
-		yuv420p_to_bgr888_stride(yuv_data, (uint8_t*)drm_buf_for_rga2.drm_buf_ptr, src_w, src_h, src_pitch);
+	if (need_display_output) {
+		printf("DEBUG: Software Display conversion: %s(%dx%d, stride=%d) -> BGR888(%dx%d)\n",
+			   format_name, src_w, src_h, planes.y_stride, display_width_, display_height_);
+		BOX_RECT full_frame = { 0, src_w, 0, src_h };
+		BOX_RECT full_display = { 0, display_width_, 0, display_height_ };
+		DmaBufCpuAccess display_access(display_buf_->drm_buf_fd, DmaBufCpuAccess::WRITE);
+		frame_planes_to_bgr888(planes, color_tables_, full_frame, (uint8_t *)display_buf_->drm_buf_ptr, display_buf_->drm_buf_pitch,
+				       full_display);
 	}
 
-	// Enhanced software fallback color debugging
-	if (drm_buf_for_rga2.drm_buf_ptr && drm_buf_for_rga1.drm_buf_ptr) {
-		// Debug display buffer (BGR format for OpenCV)
-		uint8_t* display_data = (uint8_t*)drm_buf_for_rga2.drm_buf_ptr;
-		int center_x = display_width_ / 2;
-		int center_y = display_height_ / 2;
-		int center_idx = (center_y * display_width_ + center_x) * 3;
-
-		printf("DEBUG: Software Display buffer (BGR) center pixel: B=%d, G=%d, R=%d\n",
-			   display_data[center_idx], display_data[center_idx + 1], display_data[center_idx + 2]);
+	printf("Software fallback processing completed\n");
+	return 0;
+}
 
-		// Debug RKNN buffer (BGR format for RKNN)
-		uint8_t* rknn_data = (uint8_t*)drm_buf_for_rga1.drm_buf_ptr;
-		int rknn_center_x = rknn_width_ / 2;
-		int rknn_center_y = rknn_height_ / 2;
-		int rknn_center_idx = (rknn_center_y * rknn_width_ + rknn_center_x) * 3;
+void FFmpegStreamChannel::set_roi(float x, float y, float w, float h)
+{
+	roi_x_ = std::max(0.f, std::min(x, 1.f));
+	roi_y_ = std::max(0.f, std::min(y, 1.f));
+	roi_w_ = std::max(0.f, std::min(w, 1.f - roi_x_));
+	roi_h_ = std::max(0.f, std::min(h, 1.f - roi_y_));
+	printf("ROI set to x=%.3f y=%.3f w=%.3f h=%.3f\n", roi_x_, roi_y_, roi_w_, roi_h_);
+}
 
-		printf("DEBUG: Software RKNN buffer (BGR) center pixel: B=%d, G=%d, R=%d\n",
-			   rknn_data[rknn_center_idx], rknn_data[rknn_center_idx + 1], rknn_data[rknn_center_idx + 2]);
+BOX_RECT FFmpegStreamChannel::roi_rect(int src_w, int src_h) const
+{
+	BOX_RECT r;
+	// RGA needs even offsets and sizes for 4:2:0 sources
+	r.left = (int)(roi_x_ * src_w) & ~1;
+	r.top = (int)(roi_y_ * src_h) & ~1;
+	r.right = std::min(src_w, r.left + std::max(2, (int)(roi_w_ * src_w) & ~1));
+	r.bottom = std::min(src_h, r.top + std::max(2, (int)(roi_h_ * src_h) & ~1));
+	return r;
+}
 
-		// Compare values to detect potential issues
-		if (abs(display_data[center_idx] - rknn_data[rknn_center_idx]) > 50) {
-			printf("WARNING: Large difference between display and RKNN blue channels (%d vs %d)\n",
-				   display_data[center_idx], rknn_data[rknn_center_idx]);
-		}
+void FFmpegStreamChannel::update_model_transform(ModelInputSlot *slot, int src_w, int src_h)
+{
+	// model (minus padding) -> source crop -> full source -> display
+	const BOX_RECT &crop = slot->crop;
+	const BOX_RECT &dst = slot->dst;
+	float src_to_display_x = (float)display_width_ / src_w;
+	float src_to_display_y = (float)display_height_ / src_h;
+	slot->to_display.scale_x = (float)(crop.right - crop.left) / (dst.right - dst.left) * src_to_display_x;
+	slot->to_display.scale_y = (float)(crop.bottom - crop.top) / (dst.bottom - dst.top) * src_to_display_y;
+	slot->to_display.offset_x = crop.left * src_to_display_x - dst.left * slot->to_display.scale_x;
+	slot->to_display.offset_y = crop.top * src_to_display_y - dst.top * slot->to_display.scale_y;
+}
 
-		// Check for obvious color swapping patterns
-		bool likely_rgb_in_bgr = (display_data[center_idx] > display_data[center_idx + 2]) &&
-								 (display_data[center_idx + 2] > display_data[center_idx + 1]);
-		if (likely_rgb_in_bgr) {
-			printf("WARNING: Software path - Color channels may be swapped - Blue > Red > Green suggests RGB data in BGR buffer\n");
-		}
+void FFmpegStreamChannel::layout_model_input(ModelInputSlot *slot) const
+{
+	slot->dst.left = 0;
+	slot->dst.top = 0;
+	slot->dst.right = rknn_width_;
+	slot->dst.bottom = rknn_height_;
+	if (!letterbox_) {
+		return;
 	}
 
-	// Cleanup
-	if (need_unmap && yuv_data) {
-		const AVDRMFrameDescriptor *av_drm_frame = reinterpret_cast<const AVDRMFrameDescriptor *>(frame->data[0]);
-		munmap(yuv_data, av_drm_frame->objects[0].size);
+	// Fit the crop inside the model input and center it; RGA wants even offsets and sizes
+	int crop_w = slot->crop.right - slot->crop.left;
+	int crop_h = slot->crop.bottom - slot->crop.top;
+	float scale = std::min((float)rknn_width_ / crop_w, (float)rknn_height_ / crop_h);
+	int content_w = std::min(rknn_width_, std::max(2, (int)(crop_w * scale + 0.5f) & ~1));
+	int content_h = std::min(rknn_height_, std::max(2, (int)(crop_h * scale + 0.5f) & ~1));
+	slot->dst.left = ((rknn_width_ - content_w) / 2) & ~1;
+	slot->dst.top = ((rknn_height_ - content_h) / 2) & ~1;
+	slot->dst.right = slot->dst.left + content_w;
+	slot->dst.bottom = slot->dst.top + content_h;
+}
+
+int FFmpegStreamChannel::pad_model_input(size_t index, const ModelInputSlot &slot)
+{
+	// Blits only touch the content rect, so padding survives in a buffer until the layout changes.
+	// Pool buffers move between slots, hence the record per buffer rather than per slot.
+	auto found = padded_rects_.find(slot.buf->drm_buf_ptr);
+	BOX_RECT last = found != padded_rects_.end() ? found->second : BOX_RECT{ 0, 0, 0, 0 };
+	bool full = slot.dst.left == 0 && slot.dst.top == 0 && slot.dst.right == rknn_width_ && slot.dst.bottom == rknn_height_;
+	if (full || (last.left == slot.dst.left && last.top == slot.dst.top && last.right == slot.dst.right && last.bottom == slot.dst.bottom)) {
+		padded_rects_[slot.buf->drm_buf_ptr] = slot.dst;
+		return 0;
 	}
 
-	printf("Software fallback processing completed\n");
+	int ret = -1;
+	int stride = bgr888_stride(slot.buf);
+	if (slot.buf->drm_buf_fd >= 0 && !use_software_only && stride > 0) {
+		ret = rknn_img_fill_phy(&rga_ctx, slot.buf->drm_buf_fd, stride, rknn_height_, RK_FORMAT_BGR_888, 0, 0, rknn_width_,
+					rknn_height_, LETTERBOX_PAD_COLOR);
+	}
+	if (ret != 0) {
+		// Gray padding has equal channels, so a byte fill works for any channel order
+		DmaBufCpuAccess access(slot.buf->drm_buf_fd, DmaBufCpuAccess::WRITE);
+		memset(slot.buf->drm_buf_ptr, LETTERBOX_PAD_VALUE, (size_t)slot.buf->drm_buf_pitch * rknn_height_);
+	}
+	printf("Letterbox: input %zu content %d,%d %dx%d, padding %s\n", index, slot.dst.left, slot.dst.top,
+	       slot.dst.right - slot.dst.left, slot.dst.bottom - slot.dst.top, ret == 0 ? "filled by RGA" : "memset");
+	padded_rects_[slot.buf->drm_buf_ptr] = slot.dst;
 	return 0;
 }
 
-void FFmpegStreamChannel::yuv420p_to_rgb888(const uint8_t* yuv_data, uint8_t* rgb_data, int width, int height)
+void FFmpegStreamChannel::set_tiling(int cols, int rows, float overlap, bool full_frame_pass)
 {
-	// YUV420P to RGB888 conversion with proper ITU-R BT.601 coefficients and bilinear scaling to RKNN dimensions
-	const uint8_t* y_plane = yuv_data;
-	const uint8_t* u_plane = yuv_data + width * height;
-	const uint8_t* v_plane = yuv_data + width * height + (width/2) * (height/2);
-
-	float scale_x = (float)width / rknn_width_;
-	float scale_y = (float)height / rknn_height_;
-
-	for (int dst_y = 0; dst_y < rknn_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < rknn_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			int y = y_plane[src_y * width + src_x];
-			int u = u_plane[(src_y/2) * (width/2) + (src_x/2)] - 128;
-			int v = v_plane[(src_y/2) * (width/2) + (src_x/2)] - 128;
-
-			// YUV to RGB conversion using proper ITU-R BT.601 coefficients
-			// Handle both limited range (16-235) and full range (0-255) YUV
-			// Most video content uses limited range, so try that first
-			int y_full, u_full, v_full;
-
-			// Check if this looks like limited range (Y should be mostly 16-235)
-			if (y >= 16 && y <= 235) {
-				// Limited range conversion
-				y_full = ((y - 16) * 255) / 219;
-				u_full = (u * 255) / 224;  // u is already centered at 0
-				v_full = (v * 255) / 224;  // v is already centered at 0
-			} else {
-				// Full range conversion
-				y_full = y;
-				u_full = u;
-				v_full = v;
-			}
-
-			// Clamp Y to valid range
-			y_full = std::max(0, std::min(255, y_full));
-
-			int r = y_full + (1.402f * v_full);
-			int g = y_full - (0.344136f * u_full) - (0.714136f * v_full);
-			int b = y_full + (1.772f * u_full);
-
-			// Clamp values to valid range
-			r = std::max(0, std::min(255, r));
-			g = std::max(0, std::min(255, g));
-			b = std::max(0, std::min(255, b));
-
-			int dst_idx = (dst_y * rknn_width_ + dst_x) * 3;
-			rgb_data[dst_idx] = r;
-			rgb_data[dst_idx + 1] = g;
-			rgb_data[dst_idx + 2] = b;
-		}
+	tile_cols_ = std::max(1, cols);
+	tile_rows_ = std::max(1, rows);
+	if (tile_cols_ * tile_rows_ > TILE_MAX_COUNT) {
+		printf("WARNING: %dx%d tiles exceed TILE_MAX_COUNT (%d), tiling disabled\n", tile_cols_, tile_rows_, TILE_MAX_COUNT);
+		tile_cols_ = tile_rows_ = 1;
 	}
+	tile_overlap_ = std::max(0.f, std::min(overlap, 0.5f));
+	tile_full_frame_pass_ = full_frame_pass;
+	// One input buffer per pass, the full-frame pass included; sized for the worst case so rebuilds never reallocate
+	model_inputs_.reserve(MODEL_INPUT_MAX_COUNT);
+	model_bufs_.reserve(MODEL_INPUT_MAX_COUNT);
+	printf("Tiling set to %dx%d, overlap=%.2f, full-frame pass %s\n", tile_cols_, tile_rows_, tile_overlap_,
+	       tile_full_frame_pass_ ? "on" : "off");
 }
 
-void FFmpegStreamChannel::yuv420p_to_bgr888(const uint8_t* yuv_data, uint8_t* bgr_data, int width, int height)
+int FFmpegStreamChannel::build_model_inputs(int src_w, int src_h)
 {
-	// YUV420P to BGR888 conversion with proper ITU-R BT.601 coefficients and bilinear scaling to display dimensions
-	const uint8_t* y_plane = yuv_data;
-	const uint8_t* u_plane = yuv_data + width * height;
-	const uint8_t* v_plane = yuv_data + width * height + (width/2) * (height/2);
-
-	float scale_x = (float)width / display_width_;
-	float scale_y = (float)height / display_height_;
-
-	for (int dst_y = 0; dst_y < display_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < display_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			int y = y_plane[src_y * width + src_x];
-			int u = u_plane[(src_y/2) * (width/2) + (src_x/2)] - 128;
-			int v = v_plane[(src_y/2) * (width/2) + (src_x/2)] - 128;
-
-			// YUV to RGB conversion using proper ITU-R BT.601 coefficients
-			// Handle both limited range (16-235) and full range (0-255) YUV
-			// Most video content uses limited range, so try that first
-			int y_full, u_full, v_full;
-
-			// Check if this looks like limited range (Y should be mostly 16-235)
-			if (y >= 16 && y <= 235) {
-				// Limited range conversion
-				y_full = ((y - 16) * 255) / 219;
-				u_full = (u * 255) / 224;  // u is already centered at 0
-				v_full = (v * 255) / 224;  // v is already centered at 0
-			} else {
-				// Full range conversion
-				y_full = y;
-				u_full = u;
-				v_full = v;
+	model_inputs_.clear();
+	BOX_RECT region = roi_rect(src_w, src_h);
+	int region_w = region.right - region.left;
+	int region_h = region.bottom - region.top;
+
+	if (tile_cols_ * tile_rows_ > 1) {
+		// Tiles overlap by tile_overlap_ of their own size so objects on a seam are whole in one of them
+		int tile_w = (int)(region_w / (tile_cols_ - (tile_cols_ - 1) * tile_overlap_)) & ~1;
+		int tile_h = (int)(region_h / (tile_rows_ - (tile_rows_ - 1) * tile_overlap_)) & ~1;
+		for (int row = 0; row < tile_rows_; row++) {
+			for (int col = 0; col < tile_cols_; col++) {
+				ModelInputSlot slot;
+				slot.crop.left = region.left + ((int)(col * tile_w * (1.f - tile_overlap_)) & ~1);
+				slot.crop.top = region.top + ((int)(row * tile_h * (1.f - tile_overlap_)) & ~1);
+				// The last column/row absorbs rounding so the region is fully covered
+				slot.crop.right = col == tile_cols_ - 1 ? region.right : slot.crop.left + tile_w;
+				slot.crop.bottom = row == tile_rows_ - 1 ? region.bottom : slot.crop.top + tile_h;
+				model_inputs_.push_back(slot);
 			}
+		}
+	}
 
-			// Clamp Y to valid range
-			y_full = std::max(0, std::min(255, y_full));
+	if (model_inputs_.empty() || tile_full_frame_pass_) {
+		ModelInputSlot slot;
+		slot.crop = region;
+		model_inputs_.push_back(slot);
+	}
 
-			int r = y_full + (1.402f * v_full);
-			int g = y_full - (0.344136f * u_full) - (0.714136f * v_full);
-			int b = y_full + (1.772f * u_full);
+	// Last frame's inputs go back to the pool first, so steady state recycles the same buffers
+	model_bufs_.clear();
+	for (size_t i = 0; i < model_inputs_.size(); i++) {
+		std::shared_ptr<struct drm_buf> buf =
+			buffer_pool_ ? buffer_pool_->acquire(rknn_width_, rknn_height_, RK_FORMAT_BGR_888) : nullptr;
+		if (!buf) {
+			printf("ERROR: No buffer for model input %zu\n", i);
+			return -1;
+		}
+		model_bufs_.push_back(buf);
+		model_inputs_[i].buf = buf.get();
+		layout_model_input(&model_inputs_[i]);
+		pad_model_input(i, model_inputs_[i]);
+	}
+	return 0;
+}
 
-			// Clamp values to valid range
-			r = std::max(0, std::min(255, r));
-			g = std::max(0, std::min(255, g));
-			b = std::max(0, std::min(255, b));
+void FFmpegStreamChannel::set_npu_scheduler(std::shared_ptr<NpuScheduler> scheduler, const std::string &name, float weight, float target_fps,
+					    int deadline_ms)
+{
+	npu_scheduler_ = scheduler;
+	if (npu_scheduler_) {
+		npu_sched_id_ = npu_scheduler_->register_channel(name, weight, target_fps, deadline_ms);
+	}
+}
 
-			int dst_idx = (dst_y * display_width_ + dst_x) * 3;
-			bgr_data[dst_idx] = b;     // BGR format: Blue first
-			bgr_data[dst_idx + 1] = g; // Green second
-			bgr_data[dst_idx + 2] = r; // Red third
+// Same per-sample shape, type and quantization; dims[0] is the batch
+static bool same_sample_tensor(const rknn_tensor_attr &a, const rknn_tensor_attr &b)
+{
+	if (a.n_dims != b.n_dims || a.type != b.type || a.qnt_type != b.qnt_type || a.fmt != b.fmt || a.zp != b.zp ||
+	    a.scale != b.scale) {
+		return false;
+	}
+	for (uint32_t d = 1; d < a.n_dims; d++) {
+		if (a.dims[d] != b.dims[d]) {
+			return false;
 		}
 	}
+	return true;
 }
 
-void FFmpegStreamChannel::nv12_to_rgb888(const uint8_t* nv12_data, uint8_t* rgb_data, int width, int height)
+// The broker's outputs go through this channel's decoder, so its model must match the channel's
+// tensor for tensor; anything else would decode into plausible-looking but wrong boxes
+void FFmpegStreamChannel::set_inference_broker(std::shared_ptr<InferenceBroker> broker)
 {
-	// NV12 to RGB888 conversion with proper color space handling (BT.709 + full range for modern content)
-	// NV12 format: Y plane followed by interleaved UV plane
-	const uint8_t* y_plane = nv12_data;
-	const uint8_t* uv_plane = nv12_data + width * height;
-
-	float scale_x = (float)width / rknn_width_;
-	float scale_y = (float)height / rknn_height_;
-
-	for (int dst_y = 0; dst_y < rknn_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < rknn_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			int y = y_plane[src_y * width + src_x];
-
-			// NV12 has interleaved UV: UVUVUV...
-			int uv_x = (src_x / 2) * 2;  // Align to even pixel
-			int uv_y = src_y / 2;
-			int uv_idx = uv_y * width + uv_x;
-			int u = uv_plane[uv_idx] - 128;
-			int v = uv_plane[uv_idx + 1] - 128;
-
-			// CRITICAL FIX: Use BT.709 coefficients for modern HD content (like our HEVC video)
-			// BT.709 is standard for HD content, BT.601 is for SD content
-			// Also handle full range (0-255) vs limited range (16-235)
-
-			// For full range content (which our video uses), Y is already 0-255
-			// For limited range, we'd need to scale: Y = (Y - 16) * 255 / 219
-
-			// BT.709 coefficients (more accurate for HD content)
-			float r_f = y + (1.5748f * v);
-			float g_f = y - (0.1873f * u) - (0.4681f * v);
-			float b_f = y + (1.8556f * u);
-
-			// Clamp values to valid range
-			int r = std::max(0, std::min(255, (int)r_f));
-			int g = std::max(0, std::min(255, (int)g_f));
-			int b = std::max(0, std::min(255, (int)b_f));
-
-			int dst_idx = (dst_y * rknn_width_ + dst_x) * 3;
-			rgb_data[dst_idx] = r;
-			rgb_data[dst_idx + 1] = g;
-			rgb_data[dst_idx + 2] = b;
+	if (!broker) {
+		broker_ = nullptr;
+		return;
+	}
+	const InferenceBackend &backend = broker->backend();
+	size_t input_size = (size_t)rknn_width_ * rknn_height_ * rknn_input_channel;
+	if (backend.input_size() != input_size) {
+		printf("WARNING: batch model takes %zu input bytes, channel model %zu; keeping per-channel inference\n",
+		       backend.input_size(), input_size);
+		return;
+	}
+	if (backend.num_outputs() != (int)io_num.n_output) {
+		printf("WARNING: batch model has %d outputs, channel model %u; keeping per-channel inference\n", backend.num_outputs(),
+		       io_num.n_output);
+		return;
+	}
+	for (int i = 0; i < backend.num_outputs(); i++) {
+		if (!same_sample_tensor(backend.output_attrs()[i], output_attrs[i])) {
+			printf("WARNING: batch model output %d differs from the channel model's; keeping per-channel inference\n", i);
+			return;
 		}
 	}
+	if (!decoder_ || !decoder_->accepts(backend.output_attrs(), backend.num_outputs())) {
+		printf("WARNING: batch model outputs are not %s with %d classes; keeping per-channel inference\n",
+		       decoder_ ? decoder_->name() : "decodable", decoder_ ? decoder_->num_classes() : 0);
+		return;
+	}
+	broker_ = broker;
 }
 
-void FFmpegStreamChannel::nv12_to_bgr888(const uint8_t* nv12_data, uint8_t* bgr_data, int width, int height)
+int FFmpegStreamChannel::prepare_frame(AVFrame *frame, const FrameDesc &desc, ModelInputSlot *model_input, bool need_display_output)
 {
-	// NV12 to BGR888 conversion with proper color space handling (BT.709 + full range for modern content)
-	// NV12 format: Y plane followed by interleaved UV plane
-	const uint8_t* y_plane = nv12_data;
-	const uint8_t* uv_plane = nv12_data + width * height;
-
-	float scale_x = (float)width / display_width_;
-	float scale_y = (float)height / display_height_;
-
-	for (int dst_y = 0; dst_y < display_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < display_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			int y = y_plane[src_y * width + src_x];
-
-			// NV12 has interleaved UV: UVUVUV...
-			int uv_x = (src_x / 2) * 2;  // Align to even pixel
-			int uv_y = src_y / 2;
-			int uv_idx = uv_y * width + uv_x;
-			int u = uv_plane[uv_idx] - 128;
-			int v = uv_plane[uv_idx + 1] - 128;
-
-			// CRITICAL FIX: Use BT.709 coefficients for modern HD content (like our HEVC video)
-			// BT.709 is standard for HD content, BT.601 is for SD content
-			// Also handle full range (0-255) vs limited range (16-235)
-
-			// For full range content (which our video uses), Y is already 0-255
-			// For limited range, we'd need to scale: Y = (Y - 16) * 255 / 219
-
-			// BT.709 coefficients (more accurate for HD content)
-			float r_f = y + (1.5748f * v);
-			float g_f = y - (0.1873f * u) - (0.4681f * v);
-			float b_f = y + (1.8556f * u);
-
-			// Clamp values to valid range
-			int r = std::max(0, std::min(255, (int)r_f));
-			int g = std::max(0, std::min(255, (int)g_f));
-			int b = std::max(0, std::min(255, (int)b_f));
-
-			int dst_idx = (dst_y * display_width_ + dst_x) * 3;
-			bgr_data[dst_idx] = b;     // BGR format: Blue first
-			bgr_data[dst_idx + 1] = g; // Green second
-			bgr_data[dst_idx + 2] = r; // Red third
+	// Unified frame processing using hardware acceleration with software fallback
+	int ret = 0;
+
+	bool software = true;
+	if (!use_software_only && desc.fd >= 0) {
+		// Try hardware acceleration first (DRM PRIME frames and pool-allocated software frames)
+		ret = process_frame_hardware(desc, model_input, need_display_output);
+		if (ret == 0) {
+			printf("Hardware acceleration completed successfully\n");
+			software = false;
+		} else {
+			printf("Hardware acceleration failed (ret=%d), falling back to software\n", ret);
+			ret = process_frame_software_fallback(frame, desc, model_input, need_display_output);
 		}
+	} else {
+		// Use software processing (either forced or no DRM fd available)
+		printf("Using software processing (hardware %s, fd=%d)\n",
+			   use_software_only ? "disabled" : "unavailable", desc.fd);
+		ret = process_frame_software_fallback(frame, desc, model_input, need_display_output);
+	}
+	if (need_display_output) {
+		display_from_cpu_ = ret == 0 && software;
 	}
+	return ret;
 }
 
-// Stride-aware conversion functions for proper pitch handling
-void FFmpegStreamChannel::nv12_to_rgb888_stride(const uint8_t* nv12_data, uint8_t* rgb_data, int width, int height, int stride)
+// A software-converted frame need not be converted again for the model when the display image
+// holds at least as many pixels of the crop as the model input does: the crop is then scaled out
+// of it with a plain BGR resize. Returns false, leaving the slot alone, when that would upscale
+// (ROI crops and tiles usually); those are converted from the frame planes instead.
+bool FFmpegStreamChannel::model_input_from_display(ModelInputSlot *model_input, int src_w, int src_h)
 {
-	// NV12 to RGB888 conversion with proper stride handling for pitch != width
-	const uint8_t* y_plane = nv12_data;
-	const uint8_t* uv_plane = nv12_data + stride * height;  // Use stride instead of width
-
-	float scale_x = (float)width / rknn_width_;
-	float scale_y = (float)height / rknn_height_;
-
-	for (int dst_y = 0; dst_y < rknn_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < rknn_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			// Use stride for Y plane indexing
-			int y = y_plane[src_y * stride + src_x];
-
-			// NV12 has interleaved UV: UVUVUV...
-			int uv_x = (src_x / 2) * 2;  // Align to even pixel
-			int uv_y = src_y / 2;
-			int uv_idx = uv_y * stride + uv_x;  // Use stride for UV plane indexing
-			int u = uv_plane[uv_idx] - 128;
-			int v = uv_plane[uv_idx + 1] - 128;
-
-			// BT.709 coefficients for HD content
-			float r_f = y + (1.5748f * v);
-			float g_f = y - (0.1873f * u) - (0.4681f * v);
-			float b_f = y + (1.8556f * u);
-
-			// Clamp values to valid range
-			int r = std::max(0, std::min(255, (int)r_f));
-			int g = std::max(0, std::min(255, (int)g_f));
-			int b = std::max(0, std::min(255, (int)b_f));
-
-			int dst_idx = (dst_y * rknn_width_ + dst_x) * 3;
-			rgb_data[dst_idx] = r;
-			rgb_data[dst_idx + 1] = g;
-			rgb_data[dst_idx + 2] = b;
-		}
+	const BOX_RECT &crop = model_input->crop;
+	const BOX_RECT &dst = model_input->dst;
+	float sx = (float)display_width_ / src_w;
+	float sy = (float)display_height_ / src_h;
+	if ((crop.right - crop.left) * sx < dst.right - dst.left || (crop.bottom - crop.top) * sy < dst.bottom - dst.top) {
+		return false;
 	}
+	int left = std::min(display_width_ - 1, (int)(crop.left * sx));
+	int top = std::min(display_height_ - 1, (int)(crop.top * sy));
+	int right = std::max(left + 1, std::min(display_width_, (int)(crop.right * sx + 0.5f)));
+	int bottom = std::max(top + 1, std::min(display_height_, (int)(crop.bottom * sy + 0.5f)));
+
+	cv::Mat display(cv::Size(display_width_, display_height_), CV_8UC3, display_buf_->drm_buf_ptr, display_buf_->drm_buf_pitch);
+	cv::Mat input(cv::Size(rknn_width_, rknn_height_), CV_8UC3, model_input->buf->drm_buf_ptr, model_input->buf->drm_buf_pitch);
+	cv::Mat content = input(cv::Rect(dst.left, dst.top, dst.right - dst.left, dst.bottom - dst.top));
+	DmaBufCpuAccess model_access(model_input->buf->drm_buf_fd, DmaBufCpuAccess::WRITE);
+	cv::resize(display(cv::Rect(left, top, right - left, bottom - top)), content, content.size(), 0, 0, cv::INTER_AREA);
+	update_model_transform(model_input, src_w, src_h);
+	return true;
 }
 
-void FFmpegStreamChannel::nv12_to_bgr888_stride(const uint8_t* nv12_data, uint8_t* bgr_data, int width, int height, int stride)
+// The NPU reads rows back to back; a buffer whose pitch the allocator padded is packed first
+const void *FFmpegStreamChannel::packed_model_input(const ModelInputSlot &model_input)
 {
-	// NV12 to BGR888 conversion with proper stride handling for pitch != width
-	const uint8_t* y_plane = nv12_data;
-	const uint8_t* uv_plane = nv12_data + stride * height;  // Use stride instead of width
-
-	float scale_x = (float)width / display_width_;
-	float scale_y = (float)height / display_height_;
-
-	for (int dst_y = 0; dst_y < display_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < display_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			// Use stride for Y plane indexing
-			int y = y_plane[src_y * stride + src_x];
-
-			// NV12 has interleaved UV: UVUVUV...
-			int uv_x = (src_x / 2) * 2;  // Align to even pixel
-			int uv_y = src_y / 2;
-			int uv_idx = uv_y * stride + uv_x;  // Use stride for UV plane indexing
-			int u = uv_plane[uv_idx] - 128;
-			int v = uv_plane[uv_idx + 1] - 128;
-
-			// BT.709 coefficients for HD content
-			float r_f = y + (1.5748f * v);
-			float g_f = y - (0.1873f * u) - (0.4681f * v);
-			float b_f = y + (1.8556f * u);
-
-			// Clamp values to valid range
-			int r = std::max(0, std::min(255, (int)r_f));
-			int g = std::max(0, std::min(255, (int)g_f));
-			int b = std::max(0, std::min(255, (int)b_f));
-
-			int dst_idx = (dst_y * display_width_ + dst_x) * 3;
-			bgr_data[dst_idx] = b;     // BGR format: Blue first
-			bgr_data[dst_idx + 1] = g; // Green second
-			bgr_data[dst_idx + 2] = r; // Red third
-		}
+	size_t row = (size_t)rknn_width_ * rknn_input_channel;
+	const uint8_t *src = (const uint8_t *)model_input.buf->drm_buf_ptr;
+	if ((size_t)model_input.buf->drm_buf_pitch == row) {
+		return src;
 	}
+	packed_input_.resize(row * rknn_height_);
+	DmaBufCpuAccess access(model_input.buf->drm_buf_fd, DmaBufCpuAccess::READ);
+	for (int y = 0; y < rknn_height_; y++) {
+		memcpy(&packed_input_[row * y], src + (size_t)model_input.buf->drm_buf_pitch * y, row);
+	}
+	return packed_input_.data();
 }
 
-void FFmpegStreamChannel::yuv420p_to_rgb888_stride(const uint8_t* yuv_data, uint8_t* rgb_data, int width, int height, int stride)
+int FFmpegStreamChannel::run_inference(const ModelInputSlot &model_input, detect_result_group_t *group)
 {
-	// YUV420P to RGB888 conversion with proper stride handling
-	const uint8_t* y_plane = yuv_data;
-	const uint8_t* u_plane = yuv_data + stride * height;
-	const uint8_t* v_plane = yuv_data + stride * height + (stride/2) * (height/2);
-
-	float scale_x = (float)width / rknn_width_;
-	float scale_y = (float)height / rknn_height_;
-
-	for (int dst_y = 0; dst_y < rknn_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < rknn_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			// Use stride for plane indexing
-			int y = y_plane[src_y * stride + src_x];
-			int u = u_plane[(src_y/2) * (stride/2) + (src_x/2)] - 128;
-			int v = v_plane[(src_y/2) * (stride/2) + (src_x/2)] - 128;
-
-			// BT.709 coefficients for HD content
-			float r_f = y + (1.5748f * v);
-			float g_f = y - (0.1873f * u) - (0.4681f * v);
-			float b_f = y + (1.8556f * u);
-
-			// Clamp values to valid range
-			int r = std::max(0, std::min(255, (int)r_f));
-			int g = std::max(0, std::min(255, (int)g_f));
-			int b = std::max(0, std::min(255, (int)b_f));
-
-			int dst_idx = (dst_y * rknn_width_ + dst_x) * 3;
-			rgb_data[dst_idx] = r;
-			rgb_data[dst_idx + 1] = g;
-			rgb_data[dst_idx + 2] = b;
+	if (!decoder_) {
+		printf("No detection decoder for this model, skipping inference\n");
+		return -1;
+	}
+
+	long long ts_mark = current_timestamp();
+
+	if (broker_) {
+		// Shared batch model: the broker groups this input with other channels' frames
+		if (broker_->infer(packed_model_input(model_input), broker_outputs_) != 0) {
+			printf("Batched inference failed\n");
+			return -1;
+		}
+		printf("DETECT OK (batched)---->[%fms]\n", ((double)(current_timestamp() - ts_mark)) / 1000);
+
+		// The broker reuses broker_outputs_, so after the first frame this only refreshes pointers
+		broker_output_ptrs_.resize(broker_outputs_.size());
+		for (size_t i = 0; i < broker_outputs_.size(); ++i) {
+			broker_output_ptrs_[i] = broker_outputs_[i].data();
+		}
+		decoder_->decode(broker_output_ptrs_.data(), broker_->backend().output_attrs(), rknn_height_, rknn_width_, box_conf_threshold, nms_threshold,
+				 group);
+	} else {
+		/* rknn2 compute */
+		inputs[0].buf = (void *)packed_model_input(model_input);
+		int ret = rknn_inputs_set(rknn_ctx, io_num.n_input, inputs);
+		if (ret < 0) {
+			printf("rknn_inputs_set failed: %d\n", ret);
+			return -1;
+		}
+
+		ret = rknn_run(rknn_ctx, NULL);
+		if (ret < 0) {
+			printf("rknn_run failed: %d\n", ret);
+			return -1;
 		}
+		// Outputs land in the channel's preallocated workspace
+		if (output_workspace_.fetch(rknn_ctx) < 0) {
+			return -1;
+		}
+		printf("DETECT OK---->[%fms]\n", ((double)(current_timestamp() - ts_mark)) / 1000);
+
+		/* post process: boxes come back in model input coordinates */
+		decoder_->decode(output_workspace_.buffers(), output_attrs, rknn_height_, rknn_width_, box_conf_threshold, nms_threshold,
+				 group);
+	}
+
+	// Undo the crop, letterbox and resize so boxes land in display coordinates
+	const BOX_RECT &content = model_input.dst;
+	for (int i = 0; i < group->count; i++) {
+		BOX_RECT &box = group->results[i].box;
+		box.left = std::max(box.left, content.left);
+		box.top = std::max(box.top, content.top);
+		box.right = std::min(box.right, content.right);
+		box.bottom = std::min(box.bottom, content.bottom);
+		box = model_input.to_display.apply(box);
 	}
+	return 0;
 }
 
-void FFmpegStreamChannel::yuv420p_to_bgr888_stride(const uint8_t* yuv_data, uint8_t* bgr_data, int width, int height, int stride)
+int FFmpegStreamChannel::run_model_inputs(AVFrame *frame, const FrameDesc &desc, detect_result_group_t *group)
 {
-	// YUV420P to BGR888 conversion with proper stride handling
-	const uint8_t* y_plane = yuv_data;
-	const uint8_t* u_plane = yuv_data + stride * height;
-	const uint8_t* v_plane = yuv_data + stride * height + (stride/2) * (height/2);
-
-	float scale_x = (float)width / display_width_;
-	float scale_y = (float)height / display_height_;
-
-	for (int dst_y = 0; dst_y < display_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < display_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			// Use stride for plane indexing
-			int y = y_plane[src_y * stride + src_x];
-			int u = u_plane[(src_y/2) * (stride/2) + (src_x/2)] - 128;
-			int v = v_plane[(src_y/2) * (stride/2) + (src_x/2)] - 128;
-
-			// BT.709 coefficients for HD content
-			float r_f = y + (1.5748f * v);
-			float g_f = y - (0.1873f * u) - (0.4681f * v);
-			float b_f = y + (1.8556f * u);
-
-			// Clamp values to valid range
-			int r = std::max(0, std::min(255, (int)r_f));
-			int g = std::max(0, std::min(255, (int)g_f));
-			int b = std::max(0, std::min(255, (int)b_f));
-
-			int dst_idx = (dst_y * display_width_ + dst_x) * 3;
-			bgr_data[dst_idx] = b;     // BGR format: Blue first
-			bgr_data[dst_idx + 1] = g; // Green second
-			bgr_data[dst_idx + 2] = r; // Red third
+	if (build_model_inputs(desc.width, desc.height) != 0) {
+		return -1;
+	}
+
+	// All blits first, then the NPU runs the inputs back to back
+	for (auto &slot : model_inputs_) {
+		if (display_from_cpu_ && model_input_from_display(&slot, desc.width, desc.height)) {
+			continue;
 		}
+		if (prepare_frame(frame, desc, &slot, false) != 0) {
+			printf("Model input processing failed\n");
+			return -1;
+		}
+	}
+
+	if (model_inputs_.size() == 1) {
+		return run_inference(model_inputs_[0], group);
 	}
+
+	tile_candidates_.clear();
+	for (const auto &slot : model_inputs_) {
+		if (run_inference(slot, &tile_detections_) != 0) {
+			return -1;
+		}
+		tile_candidates_.insert(tile_candidates_.end(), tile_detections_.results.begin(), tile_detections_.results.end());
+	}
+	merge_tile_detections(tile_candidates_, nms_threshold, TILE_MERGE_IOS_THRESH, group);
+	printf("TILED INFERENCE: %zu inputs, %zu candidates -> %d detections\n", model_inputs_.size(), tile_candidates_.size(),
+	       group->count);
+	return 0;
 }
 
-// Additional stride-aware conversion functions for RKNN BGR input
-void FFmpegStreamChannel::yuv420p_to_bgr888_stride_rknn(const uint8_t* yuv_data, uint8_t* bgr_data, int width, int height, int stride)
+DecodePolicy FFmpegStreamChannel::choose_decode_policy() const
 {
-	// YUV420P to BGR888 conversion with proper stride handling for RKNN dimensions
-	const uint8_t* y_plane = yuv_data;
-	const uint8_t* u_plane = yuv_data + stride * height;
-	const uint8_t* v_plane = yuv_data + stride * height + (stride/2) * (height/2);
-
-	float scale_x = (float)width / rknn_width_;
-	float scale_y = (float)height / rknn_height_;
-
-	for (int dst_y = 0; dst_y < rknn_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < rknn_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			// Use stride for plane indexing
-			int y = y_plane[src_y * stride + src_x];
-			int u = u_plane[(src_y/2) * (stride/2) + (src_x/2)] - 128;
-			int v = v_plane[(src_y/2) * (stride/2) + (src_x/2)] - 128;
-
-			// BT.709 coefficients for HD content
-			float r_f = y + (1.5748f * v);
-			float g_f = y - (0.1873f * u) - (0.4681f * v);
-			float b_f = y + (1.8556f * u);
-
-			// Clamp values to valid range
-			int r = std::max(0, std::min(255, (int)r_f));
-			int g = std::max(0, std::min(255, (int)g_f));
-			int b = std::max(0, std::min(255, (int)b_f));
-
-			int dst_idx = (dst_y * rknn_width_ + dst_x) * 3;
-			bgr_data[dst_idx] = b;     // BGR format: Blue first
-			bgr_data[dst_idx + 1] = g; // Green second
-			bgr_data[dst_idx + 2] = r; // Red third
-		}
+	if (decode_policy_ != DECODE_POLICY_AUTO) {
+		return decode_policy_;
+	}
+	int interval = inference_interval_hint_;
+	// One inference per GOP or less: the keyframes alone carry enough frames
+	if (gop_length_ > 1 && interval >= gop_length_) {
+		return DECODE_POLICY_KEYFRAMES;
+	}
+	if (interval >= DECODE_NONREF_MIN_INTERVAL) {
+		return DECODE_POLICY_NONREF;
 	}
+	return DECODE_POLICY_ALL;
 }
 
-void FFmpegStreamChannel::nv12_to_bgr888_stride_rknn(const uint8_t* nv12_data, uint8_t* bgr_data, int width, int height, int stride)
+// Called for every video packet before it is sent. Returns false when the packet must be skipped.
+bool FFmpegStreamChannel::apply_decode_policy(const AVPacket *packet)
 {
-	// NV12 to BGR888 conversion with proper stride handling for RKNN dimensions
-	const uint8_t* y_plane = nv12_data;
-	const uint8_t* uv_plane = nv12_data + stride * height;  // Use stride instead of width
-
-	float scale_x = (float)width / rknn_width_;
-	float scale_y = (float)height / rknn_height_;
-
-	for (int dst_y = 0; dst_y < rknn_height_; dst_y++) {
-		for (int dst_x = 0; dst_x < rknn_width_; dst_x++) {
-			int src_x = (int)(dst_x * scale_x);
-			int src_y = (int)(dst_y * scale_y);
-
-			// Clamp to source bounds
-			src_x = std::min(src_x, width - 1);
-			src_y = std::min(src_y, height - 1);
-
-			// Use stride for Y plane indexing
-			int y = y_plane[src_y * stride + src_x];
-
-			// NV12 has interleaved UV: UVUVUV...
-			int uv_x = (src_x / 2) * 2;  // Align to even pixel
-			int uv_y = src_y / 2;
-			int uv_idx = uv_y * stride + uv_x;  // Use stride for UV plane indexing
-			int u = uv_plane[uv_idx] - 128;
-			int v = uv_plane[uv_idx + 1] - 128;
-
-			// BT.709 coefficients for HD content
-			float r_f = y + (1.5748f * v);
-			float g_f = y - (0.1873f * u) - (0.4681f * v);
-			float b_f = y + (1.8556f * u);
-
-			// Clamp values to valid range
-			int r = std::max(0, std::min(255, (int)r_f));
-			int g = std::max(0, std::min(255, (int)g_f));
-			int b = std::max(0, std::min(255, (int)b_f));
-
-			int dst_idx = (dst_y * rknn_width_ + dst_x) * 3;
-			bgr_data[dst_idx] = b;     // BGR format: Blue first
-			bgr_data[dst_idx + 1] = g; // Green second
-			bgr_data[dst_idx + 2] = r; // Red third
+	static const char *const names[] = { "auto", "all", "non-reference skipped", "keyframes only" };
+	bool key = packet->flags & AV_PKT_FLAG_KEY;
+	if (key) {
+		if (packets_since_key_ > 0) {
+			gop_length_ = packets_since_key_;
 		}
+		packets_since_key_ = 1;
+	} else if (packets_since_key_ > 0) {
+		packets_since_key_++;
 	}
+
+	DecodePolicy wanted = choose_decode_policy();
+	// Leaving keyframes-only mode has to wait for a keyframe: the skipped frames are missing references
+	if (wanted != active_decode_policy_ && (active_decode_policy_ != DECODE_POLICY_KEYFRAMES || key)) {
+		printf("DECODE POLICY: %s -> %s (interval=%d, gop=%d)\n", names[active_decode_policy_], names[wanted],
+		       inference_interval_hint_.load(), gop_length_);
+		active_decode_policy_ = wanted;
+		// Software decoders honour skip_frame; rkmpp ignores it and decodes everything
+		codec_ctx_input_video->skip_frame = wanted == DECODE_POLICY_NONREF ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+		keyframes_only_ = wanted == DECODE_POLICY_KEYFRAMES;
+	}
+
+	if (active_decode_policy_ == DECODE_POLICY_KEYFRAMES && !key) {
+		skipped_packets_++;
+		return false;
+	}
+	return true;
 }
 
-bool FFmpegStreamChannel::check_rkmpp_decoder_availability(const char* decoder_name)
+// Source frames from the previous processed frame to this one; 1 when pts cannot tell
+int FFmpegStreamChannel::source_frames_elapsed(const AVFrame *frame)
 {
-	printf("Checking decoder: %s\n", decoder_name);
+	int64_t pts = frame->pts != AV_NOPTS_VALUE ? frame->pts : frame->pkt_pts;
+	int64_t duration = frame->pkt_duration > 0 ? frame->pkt_duration : source_frame_duration_;
+	int frames = 1;
+	if (pts != AV_NOPTS_VALUE && last_source_pts_ != AV_NOPTS_VALUE && duration > 0 && pts > last_source_pts_) {
+		int64_t n = (pts - last_source_pts_ + duration / 2) / duration;
+		if (n > 1 && n <= TRACKER_MAX_ELAPSED_FRAMES) {
+			frames = (int)n;
+		}
+	}
+	if (pts != AV_NOPTS_VALUE) {
+		last_source_pts_ = pts;
+	}
+	return frames;
+}
 
-	AVCodec* decoder = avcodec_find_decoder_by_name(decoder_name);
-	if (!decoder) {
-		printf("❌ RKMPP decoder %s not found\n", decoder_name);
-		return false;
+int FFmpegStreamChannel::process_decoded_frame(AVFrame *frame, long long received_us)
+{
+	printf("=== Frame Processing Debug ===\n");
+	printf("Received frame: format=%d (%s), decoder=%s\n",
+		   frame->format,
+		   av_get_pix_fmt_name((AVPixelFormat)frame->format),
+		   decoder_name_);
+	printf("Frame dimensions: %dx%d\n", frame->width, frame->height);
+
+	// Layout, colorspace and range come from what the decoder reports, once per frame
+	FrameDesc desc;
+	if (describe_frame(frame, &desc) != 0) {
+		printf("Unusable frame (format=%d), skipping frame\n", frame->format);
+		return -1;
+	}
+	if (desc.pitch < desc.width) {
+		desc.pitch = desc.width;
 	}
 
-	printf("✅ Decoder %s found (type: %s)\n", decoder_name,
-		   decoder->type == AVMEDIA_TYPE_VIDEO ? "video" : "other");
+	// Software frames decoded into pool buffers take the RGA path by fd
+	if (dma_frame_info(frame)) {
+		// The decoder wrote through the CPU cache; write it back before RGA reads the buffer
+		DmaBufCpuAccess flush(desc.fd, DmaBufCpuAccess::WRITE);
+	}
 
-	// Check if decoder supports DRM PRIME format
-	bool drm_prime_supported = false;
-	bool nv12_supported = false;
-	int format_count = 0;
+	// Validate dimensions to prevent RGA errors
+	if (desc.width <= 0 || desc.height <= 0 || desc.width > 4096 || desc.height > 4096) {
+		printf("Invalid frame dimensions: %dx%d, skipping frame\n", desc.width, desc.height);
+		return -1;
+	}
 
-	printf("   Supported pixel formats: ");
-	if (decoder->pix_fmts) {
-		for (int i = 0; decoder->pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
-			format_count++;
-			const char* fmt_name = av_get_pix_fmt_name(decoder->pix_fmts[i]);
-			printf("%s ", fmt_name ? fmt_name : "unknown");
+	// Check if RKNN is properly initialized using member variables
+	if (rknn_width_ <= 0 || rknn_height_ <= 0) {
+		printf("RKNN not initialized (target size: %dx%d), skipping AI inference\n",
+			   rknn_width_, rknn_height_);
+		return -1;
+	}
 
-			if (decoder->pix_fmts[i] == AV_PIX_FMT_DRM_PRIME) {
-				drm_prime_supported = true;
-			} else if (decoder->pix_fmts[i] == AV_PIX_FMT_NV12) {
-				nv12_supported = true;
-			}
-		}
+	// CRITICAL: Ensure proper YUV alignment to prevent scan line artifacts
+	// Different alignment requirements for different processing paths
+	if (frame->format == AV_PIX_FMT_DRM_PRIME) {
+		// For hardware DRM frames, align to 16-byte boundaries (RGA requirement)
+		desc.width = (desc.width + 15) & ~15;  // Align to 16-byte boundary
+		desc.height = (desc.height + 1) & ~1;  // Align to 2-pixel boundary
 	} else {
-		printf("(format list not available)");
+		// For software frames, align to 2-byte boundaries
+		desc.width = (desc.width + 1) & ~1;    // Round up to even number
+		desc.height = (desc.height + 1) & ~1;  // Round up to even number
 	}
-	printf("\n");
+	int w = desc.width;
+	int h = desc.height;
 
-	printf("   Format support: DRM_PRIME=%s, NV12=%s, total_formats=%d\n",
-		   drm_prime_supported ? "YES" : "NO",
-		   nv12_supported ? "YES" : "NO",
-		   format_count);
+	printf("Processing frame: %dx%d (pitch=%d, vstride=%d), fd=%d, %s %s range -> RKNN: %dx%d, Display: %dx%d\n",
+		   w, h, desc.pitch, desc.vstride, desc.fd, yuv_matrix_name(desc.matrix), desc.full_range ? "full" : "limited",
+		   rknn_width_, rknn_height_, display_width_, display_height_);
 
-	return true;
-}
+	long long ts_mark = current_timestamp();
 
-bool FFmpegStreamChannel::validate_hardware_acceleration()
-{
-	printf("=== Validating Hardware Acceleration Capabilities ===\n");
+	// Tracks advance by the source frames since the last processed one; the detector runs every interval() of them
+	int elapsed = source_frames_elapsed(frame);
+	tracker_.predict(elapsed);
+	bool run_detector = tracker_.should_run_inference(elapsed);
+	// In keyframes-only mode every decoded frame is already an interval apart
+	if (keyframes_only_ && frame->key_frame) {
+		run_detector = true;
+	}
 
-	// Check DRM device access
-	printf("Checking DRM device access...\n");
-	int test_fd = open("/dev/dri/card0", O_RDWR);
-	if (test_fd < 0) {
-		printf("❌ Cannot access /dev/dri/card0: %s\n", strerror(errno));
-		return false;
+	// The display image is always needed; the gate looks at it before any NPU work.
+	// Dropping the old buffer first lets the pool hand the same one back unless a stage still holds it.
+	display_buf_.reset();
+	display_buf_ = buffer_pool_ ? buffer_pool_->acquire(display_width_, display_height_, RK_FORMAT_BGR_888) : nullptr;
+	if (!display_buf_) {
+		printf("No display buffer available, skipping frame\n");
+		return -1;
+	}
+	cv::Mat mat4show(cv::Size(display_width_, display_height_), CV_8UC3, display_buf_->drm_buf_ptr, display_buf_->drm_buf_pitch);
+	if (prepare_frame(frame, desc, nullptr, true) != 0) {
+		printf("Frame processing failed, skipping RKNN inference\n");
+		return -1;
+	}
+	// From here on the CPU reads the display image (motion gate, crops, MJPEG encoding)
+	DmaBufCpuAccess display_access(display_buf_->drm_buf_fd, DmaBufCpuAccess::READ);
+
+	// Motion gate: an empty, static scene does not need the detector.
+	// With live tracks the tracker's interval decides instead.
+	if (motion_gate_.enabled()) {
+		bool scene_changed;
+		AVFrameSideData *mv_data = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
+		if (mv_data) {
+			scene_changed = motion_gate_.evaluate_motion_vectors((const AVMotionVector *)mv_data->data,
+									     mv_data->size / sizeof(AVMotionVector), w, h, ts_mark);
+		} else {
+			scene_changed = motion_gate_.evaluate((const uint8_t *)display_buf_->drm_buf_ptr, display_width_,
+							      display_height_, display_buf_->drm_buf_pitch, ts_mark);
+		}
+		if (run_detector && !scene_changed && tracker_.track_count() == 0) {
+			printf("MOTION GATE: static scene (score=%.4f), skipping inference\n", motion_gate_.last_score());
+			run_detector = false;
+		}
 	}
-	close(test_fd);
-	printf("✅ DRM device accessible\n");
 
-	// Check RGA library availability
-	printf("Checking RGA library availability...\n");
-	void* rga_handle = dlopen("/usr/lib/aarch64-linux-gnu/librga.so", RTLD_LAZY);
-	if (!rga_handle) {
-		printf("❌ RGA library not found: %s\n", dlerror());
-		return false;
+	// Shared NPU: wait for our turn; a frame that misses its deadline falls back to tracking.
+	// Its age counts from when it left the decoder, so time spent queued in live mode counts too.
+	if (run_detector && npu_scheduler_ && !npu_scheduler_->acquire(npu_sched_id_, received_us)) {
+		printf("NPU SCHEDULER: frame missed its deadline, tracking only\n");
+		run_detector = false;
 	}
 
-	// Check for required RGA functions
-	void* init_func = dlsym(rga_handle, "c_RkRgaInit");
-	void* blit_func = dlsym(rga_handle, "c_RkRgaBlit");
-	void* deinit_func = dlsym(rga_handle, "c_RkRgaDeInit");
+	// Reused every frame so its results keep their capacity
+	detect_result_group_t &detect_result_group = detections_;
+	if (run_detector) {
+		int infer_ret = run_model_inputs(frame, desc, &detect_result_group);
+		if (npu_scheduler_) {
+			npu_scheduler_->release(npu_sched_id_);
+		}
+		if (infer_ret != 0) {
+			printf("RKNN inference failed, skipping frame\n");
+			return -1;
+		}
+		tracker_.update(&detect_result_group);
+		inference_interval_hint_ = tracker_.interval();
+		printf("POST PROCESS OK---->[%fms]\n", ((double)(current_timestamp() - ts_mark)) / 1000);
+	} else {
+		tracker_.get_tracked(&detect_result_group);
+		printf("TRACK ONLY (interval=%d, tracks=%d)---->[%fms]\n", tracker_.interval(), tracker_.track_count(),
+		       ((double)(current_timestamp() - ts_mark)) / 1000);
+	}
 
-	if (!init_func || !blit_func || !deinit_func) {
-		printf("❌ Required RGA functions not found\n");
-		dlclose(rga_handle);
-		return false;
+	/* Draw Objects */
+	for (int i = 0; i < detect_result_group.count; i++) {
+		detect_result_t *det_result = &(detect_result_group.results[i]);
+		printf("---->%s @ (%d %d %d %d) %f\n", det_result->name, det_result->box.left, det_result->box.top,
+		       det_result->box.right, det_result->box.bottom, det_result->prop);
+
+		// rectangle(mat4show, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(255, 0, 0, 255), 2);
+		// putText(mat4show, text, cv::Point(x1, y1 + 12), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0));
 	}
 
-	dlclose(rga_handle);
-	printf("✅ RGA library and functions available\n");
-
-	// Check RKNN library availability
-	printf("Checking RKNN library availability...\n");
-	void* rknn_handle = dlopen("/lib/librknnrt.so", RTLD_LAZY);
-	if (!rknn_handle) {
-		// Try alternative location
-		rknn_handle = dlopen("/usr/lib/aarch64-linux-gnu/librknnrt.so", RTLD_LAZY);
-		if (!rknn_handle) {
-			// Try system search
-			rknn_handle = dlopen("librknnrt.so", RTLD_LAZY);
-			if (!rknn_handle) {
-				printf("❌ RKNN library not found: %s\n", dlerror());
-				printf("   Tried: /lib/librknnrt.so, /usr/lib/aarch64-linux-gnu/librknnrt.so, librknnrt.so\n");
-				return false;
-			}
-		}
+	/* Best-shot crops: associate across frames, save once per track */
+	if (best_shot_saver_ && run_detector && frame->pkt_pts > 0) {
+		best_shot_saver_->update(detect_result_group, mat4show, frame->pkt_pts, current_timestamp());
 	}
-	dlclose(rknn_handle);
-	printf("✅ RKNN library available\n");
 
-	printf("=== Hardware Acceleration Validation Complete ===\n");
-	return true;
+	printf("DRAW BOX OK---->[%fms]\n", ((double)(current_timestamp() - ts_mark)) / 1000);
+
+	/* MJPEG Streaming */
+	if (mjpeg_streamer_ && mjpeg_streamer_->is_running()) {
+		// Push frame to MJPEG streamer with detection results
+		mjpeg_streamer_->push_frame_raw((uint8_t*)display_buf_->drm_buf_ptr,
+										display_width_, display_height_, display_buf_->drm_buf_pitch,
+										detect_result_group,
+										!motion_gate_.enabled() || motion_gate_.content_changed());
+	}
+
+	/* OpenGL */
+	// if (image_texture != 0) {
+	// 	glDeleteTextures(1, &image_texture);
+	// 	image_texture = 0;
+	// }
+	// bind_cv_mat_to_gl_texture(mat4show, image_texture);
+
+	/* Opencv */
+	// cv::imshow(window_name, mat4show);
+	// cv::waitKey(1);
+
+	printf("SHOW OK---->[%fms]\n", ((double)(current_timestamp() - ts_mark)) / 1000);
+	return 0;
 }
 
 bool FFmpegStreamChannel::decode(const char *input_stream_url)
 {
 	int ret;
-	long long ts_mark = 0;
 
 	av_register_all();
 	avformat_network_init();
 
 	av_log_set_level(AV_LOG_INFO);
 
-	// Validate hardware acceleration capabilities at startup
-	if (!use_software_only) {
-		printf("=== Hardware Acceleration Startup Validation ===\n");
-
-		// First validate the hardware environment
-		if (!validate_hardware_acceleration()) {
-			printf("❌ Hardware acceleration validation failed, forcing software-only mode\n");
-			use_software_only = true;
-		} else {
-			printf("✅ Hardware acceleration environment validated\n");
-
-			// Then check RKMPP decoder availability
-			printf("=== Checking RKMPP decoder availability ===\n");
-			check_rkmpp_decoder_availability("h264_rkmpp");
-			check_rkmpp_decoder_availability("hevc_rkmpp");
-			check_rkmpp_decoder_availability("av1_rkmpp");
-			check_rkmpp_decoder_availability("vp9_rkmpp");
-			printf("=== RKMPP decoder check completed ===\n");
-		}
-	}
-
-	AVDictionary *opts = NULL;
-	av_dict_set(&opts, "rtsp_transport", "+udp+tcp", 0);
-	av_dict_set(&opts, "rtsp_flags", "+prefer_tcp", 0);
-	av_dict_set(&opts, "threads", "auto", 0);
-
-	format_context_input = avformat_alloc_context();
-	ret = avformat_open_input(&format_context_input, input_stream_url, NULL, &opts);
-	if (ret < 0) {
-		printf("avformat_open_input filed: %d\n", ret);
-		return false;
+	// Validated once per process; every later session and channel reuses the result
+	if (!use_software_only && !HardwareRuntime::instance().hardware_available()) {
+		printf("❌ Hardware acceleration validation failed, forcing software-only mode\n");
+		use_software_only = true;
 	}
 
-	ret = avformat_find_stream_info(format_context_input, NULL);
-	if (ret < 0) {
-		printf("avformat_find_stream_info filed: %d\n", ret);
-		return false;
+	long long open_start_us = current_timestamp();
+	if (prefetched_input_) {
+		// Opened in parallel with channel start-up
+		format_context_input = prefetched_input_;
+		prefetched_input_ = nullptr;
+	} else {
+		format_context_input = open_stream_input(input_stream_url, find_open_profile(open_profile_, input_stream_url));
+		if (!format_context_input) {
+			return false;
+		}
 	}
 
 	av_dump_format(format_context_input, 0, input_stream_url, 0);
@@ -1108,7 +1055,7 @@ bool FFmpegStreamChannel::decode(const char *input_stream_url)
 		AVStream *stream_input = format_context_input->streams[video_stream_index_input];
 
 		// Detect codec type from stream
-		AVCodecID codec_id = stream_input->codec->codec_id;
+		AVCodecID codec_id = stream_input->codecpar->codec_id;
 		const char* codec_name = avcodec_get_name(codec_id);
 		printf("Detected video codec: %s (ID: %d)\n", codec_name, codec_id);
 
@@ -1158,7 +1105,8 @@ bool FFmpegStreamChannel::decode(const char *input_stream_url)
 			return false;
 		}
 
-		avcodec_copy_context(codec_ctx_input_video, stream_input->codec);
+		// codecpar rather than the deprecated stream codec context: only codecpar is filled from cached stream info
+		avcodec_parameters_to_context(codec_ctx_input_video, stream_input->codecpar);
 
 		// Configure decoder based on type
 		bool is_hardware_decoder = (strstr(codec_input_video->name, "_rkmpp") != nullptr);
@@ -1172,6 +1120,15 @@ bool FFmpegStreamChannel::decode(const char *input_stream_url)
 		if (use_software_only || !is_hardware_decoder) {
 			// Software decoder configuration
 			printf("Configuring software decoder (%s) with YUV420P format\n", codec_input_video->name);
+			if (motion_gate_.enabled()) {
+				// Motion vectors come for free from software decoders and feed the motion gate
+				codec_ctx_input_video->flags2 |= AV_CODEC_FLAG2_EXPORT_MVS;
+			}
+			// Decoded planes land in DMA buffers, so RGA still scales and converts them
+			if (SW_DECODE_DMA_FRAMES && !use_software_only && surface_pool_ &&
+			    install_dma_get_buffer(codec_ctx_input_video, surface_pool_.get())) {
+				printf("   - Frames allocated in DMA buffers for RGA\n");
+			}
 		} else {
 			// Hardware decoder (h264_rkmpp or hevc_rkmpp) configuration for DRM PRIME output
 			printf("Configuring hardware decoder (%s) for DRM PRIME output\n", codec_input_video->name);
@@ -1303,6 +1260,7 @@ bool FFmpegStreamChannel::decode(const char *input_stream_url)
 
 		// Verify the actual pixel format after opening the decoder
 		printf("Video decoder initialized successfully: %s\n", codec_input_video->name);
+		decoder_name_ = codec_input_video->name;
 		printf("Decoder output pixel format: %s (%d)\n",
 			   av_get_pix_fmt_name(codec_ctx_input_video->pix_fmt), codec_ctx_input_video->pix_fmt);
 
@@ -1322,314 +1280,130 @@ bool FFmpegStreamChannel::decode(const char *input_stream_url)
 	{
 		audio_stream_index_input = av_find_best_stream(format_context_input, AVMEDIA_TYPE_AUDIO, -1, -1, NULL, 0);
 		AVStream *stream_input = format_context_input->streams[video_stream_index_input];
-		codec_input_audio = avcodec_find_decoder(stream_input->codec->codec_id);
+		codec_input_audio = avcodec_find_decoder(stream_input->codecpar->codec_id);
 		codec_ctx_input_audio = avcodec_alloc_context3(codec_input_audio);
-		avcodec_copy_context(codec_ctx_input_audio, stream_input->codec);
+		avcodec_parameters_to_context(codec_ctx_input_audio, stream_input->codecpar);
 	}
 
-	/* Init Mat */
-	cv::Mat *mat4show = new cv::Mat(cv::Size(display_width_, display_height_), CV_8UC3, drm_buf_for_rga2.drm_buf_ptr);
-
 	printf("DEBUG: Starting frame processing loop...\n");
 	printf("DEBUG: Hardware acceleration: %s\n", use_software_only ? "DISABLED" : "ENABLED");
 	printf("DEBUG: RKNN dimensions: %dx%d (member: %dx%d)\n", rknn_input_width, rknn_input_height, rknn_width_, rknn_height_);
 	printf("DEBUG: Display dimensions: %dx%d (member: %dx%d)\n", WIDTH_P, HEIGHT_P, display_width_, display_height_);
 
+	// Every session starts decoding everything until the GOP length is known
+	active_decode_policy_ = DECODE_POLICY_ALL;
+	keyframes_only_ = false;
+	gop_length_ = 0;
+	packets_since_key_ = 0;
+	skipped_packets_ = 0;
+
+	// Source frame length for the tracker, for packets that carry no duration
+	AVStream *video_stream = format_context_input->streams[video_stream_index_input];
+	source_frame_duration_ = 0;
+	if (video_stream->avg_frame_rate.num > 0 && video_stream->avg_frame_rate.den > 0) {
+		source_frame_duration_ = av_rescale_q(1, av_inv_q(video_stream->avg_frame_rate), video_stream->time_base);
+	}
+	last_source_pts_ = AV_NOPTS_VALUE;
+
+	// Live sources: decode keeps pace with the stream, processing takes the newest frame
+	bool live = live_mode_ && is_live_source(input_stream_url);
+	std::thread live_worker;
+	if (live) {
+		printf("LIVE MODE: latest-frame-wins processing enabled\n");
+		latest_frame_.reset();
+		live_worker = std::thread([this] {
+			AVFrame *frame = av_frame_alloc();
+			long long received_us = 0;
+			while (latest_frame_.take(frame, &received_us)) {
+				process_decoded_frame(frame, received_us);
+				av_frame_unref(frame);
+			}
+			av_frame_free(&frame);
+		});
+	}
+
+	// Files loop in place: seek back and flush instead of reopening everything
+	bool loop = loop_files_ && !is_live_source(input_stream_url);
+	int loop_count = 0;
+	pts_offset_ = 0;
+	pass_start_pts_ = AV_NOPTS_VALUE;
+	pass_end_pts_ = AV_NOPTS_VALUE;
+
+	// A pass that reads no video at all would otherwise seek or reopen in a tight loop
+	int pass_packets = 0;
+	bool empty_pass = false;
+
+	bool stream_info_stored = false;
 	AVPacket *packet_input_tmp = av_packet_alloc();
 	AVFrame *frame_input_tmp = av_frame_alloc();
-	while (true) {
+	while (!should_stop_processing) {
 		ret = av_read_frame(format_context_input, packet_input_tmp);
+		if (ret == AVERROR_EOF && pass_packets == 0) {
+			printf("EOF: no video packets in %s since %s, giving up on this session\n", input_stream_url,
+			       loop_count > 0 ? "the last seek" : "open");
+			empty_pass = true;
+			break;
+		}
+		if (ret == AVERROR_EOF && loop) {
+			// Frames still inside the decoder belong to this pass
+			avcodec_send_packet(codec_ctx_input_video, NULL);
+			receive_frames(frame_input_tmp, live);
+			avcodec_flush_buffers(codec_ctx_input_video);
+
+			int64_t start = format_context_input->start_time != AV_NOPTS_VALUE ? format_context_input->start_time : 0;
+			ret = avformat_seek_file(format_context_input, -1, INT64_MIN, start, start, 0);
+			if (ret < 0) {
+				printf("LOOP: seek to start failed: %d, reopening instead\n", ret);
+				break;
+			}
+			// The next pass continues where this one ended
+			if (pass_start_pts_ != AV_NOPTS_VALUE && pass_end_pts_ != AV_NOPTS_VALUE) {
+				pts_offset_ += pass_end_pts_ - pass_start_pts_;
+			}
+			pass_start_pts_ = AV_NOPTS_VALUE;
+			pass_end_pts_ = AV_NOPTS_VALUE;
+			pass_packets = 0;
+			loop_count++;
+			printf("LOOP: restarting %s (loop #%d, pts offset %lld)\n", input_stream_url, loop_count, (long long)pts_offset_);
+			continue;
+		}
 		if (ret < 0) {
 			break;
 		}
 
-		AVStream *stream_input = format_context_input->streams[packet_input_tmp->stream_index];
-
 		/* video */
 		if (packet_input_tmp->stream_index == video_stream_index_input) {
 			video_frame_size += packet_input_tmp->size;
 			video_frame_count++;
+			pass_packets++;
+
+			if (packet_input_tmp->pts != AV_NOPTS_VALUE) {
+				if (pass_start_pts_ == AV_NOPTS_VALUE || packet_input_tmp->pts < pass_start_pts_) {
+					pass_start_pts_ = packet_input_tmp->pts;
+				}
+				int64_t end = packet_input_tmp->pts + std::max<int64_t>(packet_input_tmp->duration, 1);
+				if (pass_end_pts_ == AV_NOPTS_VALUE || end > pass_end_pts_) {
+					pass_end_pts_ = end;
+				}
+			}
+
+			if (!apply_decode_policy(packet_input_tmp)) {
+				av_packet_unref(packet_input_tmp);
+				continue;
+			}
 
 			ret = avcodec_send_packet(codec_ctx_input_video, packet_input_tmp);
 			if (ret < 0) {
 				printf("avcodec_send_packet failed: %d (recoverable error, skipping packet...)\n", ret);
+				av_packet_unref(packet_input_tmp);
 				continue;  // Skip this packet and continue with next
 			}
 
-			while (ret >= 0) {
-				ret = avcodec_receive_frame(codec_ctx_input_video, frame_input_tmp);
-				if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-					break;
-				} else if (ret < 0) {
-					printf("avcodec_receive_frame failed: %d (recoverable error, continuing...)\n", ret);
-					break;  // Break from inner loop but continue processing
-				}
-
-				// Handle different frame formats with detailed debugging
-				const AVDRMFrameDescriptor *av_drm_frame = nullptr;
-				int fd = -1;
-
-				printf("=== Frame Processing Debug ===\n");
-				printf("Received frame: format=%d (%s), decoder=%s\n",
-					   frame_input_tmp->format,
-					   av_get_pix_fmt_name((AVPixelFormat)frame_input_tmp->format),
-					   codec_input_video->name);
-				printf("Frame dimensions: %dx%d\n", frame_input_tmp->width, frame_input_tmp->height);
-
-				if (frame_input_tmp->format == AV_PIX_FMT_DRM_PRIME) {
-					printf("✅ DRM PRIME frame detected - hardware acceleration possible\n");
-					av_drm_frame = reinterpret_cast<const AVDRMFrameDescriptor *>(frame_input_tmp->data[0]);
-					if (av_drm_frame && av_drm_frame->nb_objects > 0) {
-						fd = av_drm_frame->objects[0].fd;
-						printf("DRM PRIME details:\n");
-						printf("   - File descriptor: %d\n", fd);
-						printf("   - Number of objects: %d\n", av_drm_frame->nb_objects);
-						printf("   - Number of layers: %d\n", av_drm_frame->nb_layers);
-
-						// Validate the DRM frame structure
-						if (fd > 0 && av_drm_frame->nb_layers > 0) {
-							printf("   - Object size: %zu bytes\n", av_drm_frame->objects[0].size);
-							if (av_drm_frame->layers[0].nb_planes > 0) {
-								printf("   - First plane format: %u\n", av_drm_frame->layers[0].format);
-								printf("   - First plane pitch: %d\n", av_drm_frame->layers[0].planes[0].pitch);
-								printf("   - First plane offset: %d\n", av_drm_frame->layers[0].planes[0].offset);
-							}
-							printf("✅ DRM PRIME frame structure is valid\n");
-						} else {
-							printf("❌ DRM PRIME frame structure is invalid (fd=%d, layers=%d)\n",
-								   fd, av_drm_frame->nb_layers);
-							fd = -1;
-						}
-
-						// Print layer information for debugging
-						for (int i = 0; i < av_drm_frame->nb_layers; i++) {
-							const AVDRMLayerDescriptor *layer = &av_drm_frame->layers[i];
-							printf("Debug: Layer %d - format=0x%x, nb_planes=%d\n",
-								   i, layer->format, layer->nb_planes);
-
-							// Check for common YUV formats
-							const char* format_name = "UNKNOWN";
-							switch (layer->format) {
-								case 0x3231564e: format_name = "NV12"; break;  // 'NV12'
-								case 0x3132564e: format_name = "NV21"; break;  // 'NV21'
-								case 0x30323449: format_name = "I420"; break;  // 'I420'
-								case 0x56595559: format_name = "YUYV"; break;  // 'YUYV'
-								case 0x59565955: format_name = "UYVY"; break;  // 'UYVY'
-								default: break;
-							}
-							printf("Debug: Layer %d format name: %s\n", i, format_name);
-
-							// CRITICAL FIX: If format is 0x0 (unknown), infer format from frame characteristics
-							if (layer->format == 0x0 && layer->nb_planes == 2) {
-								// For RKMPP decoders, 2-plane format is typically NV12
-								printf("Debug: Format 0x0 detected with 2 planes - inferring NV12 format\n");
-
-								// Verify this looks like NV12 by checking plane characteristics
-								if (layer->nb_planes >= 2) {
-									int y_plane_size = layer->planes[0].pitch * codec_ctx_input_video->height;
-									int uv_plane_offset = layer->planes[1].offset;
-
-									printf("Debug: Y plane size=%d, UV plane offset=%d\n", y_plane_size, uv_plane_offset);
-
-									// NV12 has UV plane starting after Y plane
-									if (uv_plane_offset >= y_plane_size * 3/4) {  // Allow some tolerance
-										format_name = "NV12 (inferred)";
-										printf("Debug: Frame characteristics match NV12 format\n");
-									}
-								}
-							}
-
-							// Print plane information
-							for (int j = 0; j < layer->nb_planes; j++) {
-								printf("Debug: Layer %d, Plane %d - offset=%d, pitch=%d\n",
-									   i, j, layer->planes[j].offset, layer->planes[j].pitch);
-							}
-						}
-					} else {
-						printf("Debug: Invalid DRM PRIME frame descriptor\n");
-						fd = -1;
-					}
-				} else {
-					printf("Debug: Software decoded frame, format=%d (%s)\n",
-						   frame_input_tmp->format,
-						   av_get_pix_fmt_name((AVPixelFormat)frame_input_tmp->format));
-				}
-
-				// CRITICAL FIX: Use frame dimensions instead of codec context for actual frame size
-				// This prevents scan line artifacts caused by dimension mismatches
-				int w, h, pitch = 0;
-
-				if (frame_input_tmp->format == AV_PIX_FMT_DRM_PRIME) {
-					// For DRM PRIME frames, use the actual frame dimensions
-					w = frame_input_tmp->width;
-					h = frame_input_tmp->height;
-
-					// Extract pitch from DRM frame descriptor
-					if (av_drm_frame && av_drm_frame->nb_layers > 0 && av_drm_frame->layers[0].nb_planes > 0) {
-						pitch = av_drm_frame->layers[0].planes[0].pitch;
-						printf("DEBUG: Extracted pitch=%d from DRM frame (width=%d)\n", pitch, w);
-					} else {
-						pitch = w;  // Fallback to width if pitch extraction fails
-						printf("DEBUG: Failed to extract pitch, using width=%d as pitch\n", pitch);
-					}
-
-					// If frame dimensions are 0, fall back to codec context
-					if (w <= 0 || h <= 0) {
-						w = codec_ctx_input_video->width;
-						h = codec_ctx_input_video->height;
-						if (pitch <= 0) pitch = w;  // Update pitch if dimensions changed
-					}
-				} else {
-					// For software frames, use codec context dimensions
-					w = codec_ctx_input_video->width;
-					h = codec_ctx_input_video->height;
-					pitch = w;  // For software frames, pitch equals width
-				}
-
-				// Validate dimensions to prevent RGA errors
-				if (w <= 0 || h <= 0 || w > 4096 || h > 4096) {
-					printf("Invalid frame dimensions: %dx%d, skipping frame\n", w, h);
-					continue;
-				}
-
-				// Check if RKNN is properly initialized using member variables
-				if (rknn_width_ <= 0 || rknn_height_ <= 0) {
-					printf("RKNN not initialized (target size: %dx%d), skipping AI inference\n",
-						   rknn_width_, rknn_height_);
-					continue;
-				}
-
-				// CRITICAL: Ensure proper YUV alignment to prevent scan line artifacts
-				// Different alignment requirements for different processing paths
-				if (frame_input_tmp->format == AV_PIX_FMT_DRM_PRIME) {
-					// For hardware DRM frames, align to 16-byte boundaries (RGA requirement)
-					w = (w + 15) & ~15;  // Align to 16-byte boundary
-					h = (h + 1) & ~1;    // Align to 2-pixel boundary
-				} else {
-					// For software frames, align to 2-byte boundaries
-					w = (w + 1) & ~1;  // Round up to even number
-					h = (h + 1) & ~1;  // Round up to even number
-				}
-
-				printf("Processing frame: %dx%d (pitch=%d), fd=%d -> RKNN: %dx%d, Display: %dx%d\n",
-					   w, h, pitch, fd, rknn_width_, rknn_height_, display_width_, display_height_);
-
-				ts_mark = current_timestamp();
-
-				// Unified frame processing using hardware acceleration with software fallback
-				int processing_ret = 0;
-
-				if (!use_software_only && fd >= 0) {
-					// Try hardware acceleration first (DRM PRIME frames)
-					processing_ret = process_frame_hardware(fd, w, h, pitch);
-					if (processing_ret == 0) {
-						printf("Hardware acceleration completed successfully\n");
-					} else {
-						printf("Hardware acceleration failed (ret=%d), falling back to software\n", processing_ret);
-						processing_ret = process_frame_software_fallback(frame_input_tmp, w, h, pitch);
-					}
-				} else {
-					// Use software processing (either forced or no DRM fd available)
-					printf("Using software processing (hardware %s, fd=%d)\n",
-						   use_software_only ? "disabled" : "unavailable", fd);
-					processing_ret = process_frame_software_fallback(frame_input_tmp, w, h, pitch);
-				}
-
-				if (processing_ret != 0) {
-					printf("Frame processing failed, skipping RKNN inference\n");
-					continue;
-				}
-
-				/* rknn2 compute */
-				inputs[0].buf = drm_buf_for_rga1.drm_buf_ptr;
-				rknn_inputs_set(rknn_ctx, io_num.n_input, inputs);
-
-				rknn_output outputs[io_num.n_output];
-				memset(outputs, 0, sizeof(outputs));
-				for (int i = 0; i < io_num.n_output; i++) {
-					outputs[i].want_float = 0;
-				}
-
-				ret = rknn_run(rknn_ctx, NULL);
-				ret = rknn_outputs_get(rknn_ctx, io_num.n_output, outputs, NULL);
-				printf("DETECT OK---->[%fms]\n", ((double)(current_timestamp() - ts_mark)) / 1000);
-
-				/* post process */
-				float scale_w = (float)rknn_width_ / display_width_;
-				float scale_h = (float)rknn_height_ / display_height_;
-
-				detect_result_group_t detect_result_group;
-				std::vector<float> out_scales;
-				std::vector<int32_t> out_zps;
-				for (int i = 0; i < io_num.n_output; ++i) {
-					out_scales.push_back(output_attrs[i].scale);
-					out_zps.push_back(output_attrs[i].zp);
-				}
-				post_process((int8_t *)outputs[0].buf, (int8_t *)outputs[1].buf, (int8_t *)outputs[2].buf, rknn_height_, rknn_width_,
-					     box_conf_threshold, nms_threshold, scale_w, scale_h, out_zps, out_scales, &detect_result_group);
-				printf("POST PROCESS OK---->[%fms]\n", ((double)(current_timestamp() - ts_mark)) / 1000);
-
-				/* Draw Objects */
-				char text[256];
-				char file_name[256];
-				for (int i = 0; i < detect_result_group.count; i++) {
-					detect_result_t *det_result = &(detect_result_group.results[i]);
-					sprintf(text, "%s %.1f%%", det_result->name, det_result->prop * 100);
-					sprintf(file_name, "%ld_%s_%.1f", frame_input_tmp->pkt_pts, det_result->name, det_result->prop * 100);
-
-					printf("---->%s @ (%d %d %d %d) %f\n", det_result->name, det_result->box.left, det_result->box.top,
-					       det_result->box.right, det_result->box.bottom, det_result->prop);
-
-					int x1 = det_result->box.left;
-					int y1 = det_result->box.top;
-					int x2 = det_result->box.right;
-					int y2 = det_result->box.bottom;
-
-					if (frame_input_tmp->pkt_pts > 0 && std::string(det_result->name) == "person" && processing_ret == 0) {
-						// Only save if display buffer is valid
-						cv::Rect rect_box(x1, y1, x2 - x1, y2 - y1);
-						// Use current directory instead of non-existent path
-						std::string save_path = "./detections/" + std::string(file_name) + ".jpg";
-
-						// Create directory if it doesn't exist
-						system("mkdir -p ./detections");
-
-						try {
-							cv::imwrite(save_path, cv::Mat(*mat4show, rect_box));
-							printf("Saved detection: %s\n", save_path.c_str());
-						} catch (const std::exception& e) {
-							printf("Failed to save detection: %s\n", e.what());
-						}
-					}
-
-					// rectangle(*mat4show, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(255, 0, 0, 255), 2);
-					// putText(*mat4show, text, cv::Point(x1, y1 + 12), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 0, 0));
-				}
-				printf("DRAW BOX OK---->[%fms]\n", ((double)(current_timestamp() - ts_mark)) / 1000);
-
-				/* MJPEG Streaming */
-				if (mjpeg_streamer_ && mjpeg_streamer_->is_running()) {
-					// Push frame to MJPEG streamer with detection results
-					mjpeg_streamer_->push_frame_raw((uint8_t*)drm_buf_for_rga2.drm_buf_ptr,
-													display_width_, display_height_,
-													detect_result_group);
-				}
-
-				/* Free Outputs */
-				rknn_outputs_release(rknn_ctx, io_num.n_output, outputs);
-
-				/* OpenGL */
-				// if (image_texture != 0) {
-				// 	glDeleteTextures(1, &image_texture);
-				// 	image_texture = 0;
-				// }
-				// bind_cv_mat_to_gl_texture(*mat4show, image_texture);
-
-				/* Opencv */
-				// cv::imshow(window_name, *mat4show);
-				// cv::waitKey(1);
-
-				printf("SHOW OK---->[%fms]\n", ((double)(current_timestamp() - ts_mark)) / 1000);
+			if (receive_frames(frame_input_tmp, live) > 0 && !stream_info_stored) {
+				// The session works: later reconnects may skip probing
+				StreamInfoCache::instance().store(input_stream_url, format_context_input->streams[video_stream_index_input]);
+				stream_info_stored = true;
+				printf("OPEN: first frame %.1fms after open started\n", (current_timestamp() - open_start_us) / 1000.0);
 			}
 		}
 
@@ -1643,9 +1417,69 @@ bool FFmpegStreamChannel::decode(const char *input_stream_url)
 		av_frame_unref(frame_input_tmp);
 	}
 
+	if (live) {
+		latest_frame_.close();
+		live_worker.join();
+		LatestFrameSlot::Stats stats = latest_frame_.get_stats();
+		printf("LIVE MODE: %lld frames decoded, %lld processed, %lld superseded\n", stats.published, stats.consumed,
+		       stats.superseded);
+	}
+
+	if (skipped_packets_ > 0) {
+		printf("DECODE POLICY: %lld of %d video packets skipped before the decoder\n", skipped_packets_, video_frame_count);
+	}
+
 	av_packet_free(&packet_input_tmp);
+	av_frame_free(&frame_input_tmp);
 	avformat_close_input(&format_context_input);
-	return true;
+	// Reported as a failure so decode_continuous() backs off before reopening
+	return !empty_pass;
+}
+
+// Hand every frame the decoder has ready to processing. Returns the number of frames.
+int FFmpegStreamChannel::receive_frames(AVFrame *frame, bool live)
+{
+	int count = 0;
+	while (true) {
+		int ret = avcodec_receive_frame(codec_ctx_input_video, frame);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+			break;
+		} else if (ret < 0) {
+			printf("avcodec_receive_frame failed: %d (recoverable error, continuing...)\n", ret);
+			break;  // Break from inner loop but continue processing
+		}
+
+		// Whatever the frame leaves out comes from the codec context here, on the decode thread;
+		// the live processing thread only sees the frame
+		if (frame->width <= 0 || frame->height <= 0) {
+			frame->width = codec_ctx_input_video->width;
+			frame->height = codec_ctx_input_video->height;
+		}
+		if (frame->colorspace == AVCOL_SPC_UNSPECIFIED) {
+			frame->colorspace = codec_ctx_input_video->colorspace;
+		}
+		if (frame->color_range == AVCOL_RANGE_UNSPECIFIED) {
+			frame->color_range = codec_ctx_input_video->color_range;
+		}
+
+		// Looped files: timestamps keep increasing across passes
+		if (frame->pts != AV_NOPTS_VALUE) {
+			frame->pts += pts_offset_;
+		}
+		if (frame->pkt_pts != AV_NOPTS_VALUE) {
+			frame->pkt_pts += pts_offset_;
+		}
+
+		count++;
+		long long received_us = current_timestamp();
+		if (live) {
+			// The processing thread picks up whatever is newest when it is ready
+			latest_frame_.put(frame, received_us);
+		} else {
+			process_decoded_frame(frame, received_us);
+		}
+	}
+	return count;
 }
 
 void FFmpegStreamChannel::stop_processing() {
@@ -1675,6 +1509,14 @@ void FFmpegStreamChannel::cleanup_ffmpeg_contexts() {
 		format_context_input = nullptr;
 	}
 
+	// Mappings keep the old decoder's surfaces alive
+	DmaBufMapCache::Stats map_stats = surface_maps_.get_stats();
+	if (map_stats.hits + map_stats.misses > 0) {
+		printf("Decoder surface mappings: %d cached, %lld hits, %lld maps\n", map_stats.entries, map_stats.hits,
+		       map_stats.misses);
+	}
+	surface_maps_.clear();
+
 	// Reset stream indices
 	video_stream_index_input = -1;
 	audio_stream_index_input = -1;
@@ -1713,6 +1555,8 @@ bool FFmpegStreamChannel::decode_continuous(const char *input_stream_url) {
 			printf("Video processing completed normally (session #%d), restarting...\n", restart_count);
 			consecutive_failures = 0;  // Reset failure counter on success
 		} else {
+			// Stale stream info may be the reason; probe properly next time
+			StreamInfoCache::instance().invalidate(input_stream_url);
 			consecutive_failures++;
 			printf("Video processing failed (session #%d, failure #%d/%d), retrying in 2 seconds...\n",
 				   restart_count, consecutive_failures, max_consecutive_failures);
@@ -1725,8 +1569,12 @@ bool FFmpegStreamChannel::decode_continuous(const char *input_stream_url) {
 			std::this_thread::sleep_for(std::chrono::seconds(2));
 		}
 
-		// Brief pause between restarts to prevent rapid cycling
-		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		// Brief pause between reconnects so a server that drops us is not hammered;
+		// files loop inside decode() and only get here when seeking failed or a pass was
+		// empty, which decode() reports as a failure so the retry delay applies
+		if (is_live_source(input_stream_url)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		}
 	}
 
 	// Final cleanup
@@ -13,6 +13,7 @@
 #include <iostream>
 #include <atomic>
 #include <memory>
+#include <map>
 #include <sys/ioctl.h>
 #include <cstdio>
 #include <sys/mman.h>
@@ -42,6 +43,7 @@ extern "C" {
 #include <libavutil/hwcontext_drm.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/mathematics.h>
+#include <libavutil/motion_vector.h>
 #include <libavutil/opt.h>
 #include <libavutil/timestamp.h>
 #include <libswresample/swresample.h>
@@ -54,6 +56,47 @@ extern "C" {
 #include "drm_func.h"
 #include "rga_func.h"
 #include "mjpeg_streamer.h"
+#include "best_shot_saver.h"
+#include "object_tracker.h"
+#include "motion_gate.h"
+#include "box_utils.h"
+#include "detection_decoder.h"
+#include "inference_broker.h"
+#include "npu_scheduler.h"
+#include "latest_frame.h"
+#include "stream_open.h"
+#include "hw_runtime.h"
+#include "dma_buffer_pool.h"
+#include "dmabuf_map.h"
+#include "frame_planes.h"
+#include "dma_frame_alloc.h"
+#include "frame_desc.h"
+#include "rknn_outputs.h"
+
+// Which model a channel runs and how its outputs are decoded
+struct ModelConfig {
+	std::string model_path = MODEL_PATH;
+	std::string labels_path = LABEL_NALE_TXT_PATH;
+	std::string decoder = "auto"; // "auto", "yolov5" or "yolov8"
+	std::string classes = DETECT_CLASSES_DEFAULT; // comma-separated labels to detect; "" detects every class
+};
+
+// One model input filled from the decoded frame: the source crop, the
+// buffer it is scaled into and the way back to display coordinates
+struct ModelInputSlot {
+	BOX_RECT crop;
+	BOX_RECT dst; // where the crop lands in the model input; the rest is letterbox padding
+	struct drm_buf *buf = nullptr;
+	BoxTransform to_display;
+};
+
+// How much of the video stream a channel decodes
+enum DecodePolicy {
+	DECODE_POLICY_AUTO,      // follow the tracker's inference interval
+	DECODE_POLICY_ALL,       // every frame
+	DECODE_POLICY_NONREF,    // drop frames nothing references (AVDISCARD_NONREF)
+	DECODE_POLICY_KEYFRAMES, // keyframes only; other packets never reach the decoder
+};
 
 class FFmpegStreamChannel {
     public:
@@ -67,16 +110,23 @@ class FFmpegStreamChannel {
 
 	AVCodecContext *codec_ctx_input_video;
 	AVCodecContext *codec_ctx_input_audio;
+	const char *decoder_name_ = ""; // set before processing starts; the live worker reads this, not the codec
 
 	int video_frame_size = 0;
 	int audio_frame_size = 0;
 	int video_frame_count = 0;
 	int audio_frame_count = 0;
 
-	drm_context drm_ctx;
 	rga_context rga_ctx;
-	struct drm_buf drm_buf_for_rga1;
-	struct drm_buf drm_buf_for_rga2;
+	// Exact-size DMA buffers, recycled by reference count. display_buf_ holds the current
+	// frame's display image, model_bufs_ its model inputs.
+	std::shared_ptr<DmaBufferPool> buffer_pool_;
+	std::shared_ptr<DmaBufferPool> surface_pool_; // software decoder frames; buffer_pool_ unless a cached backend is available
+	std::shared_ptr<struct drm_buf> display_buf_;
+	bool display_from_cpu_ = false; // display_buf_ was converted in software; coarse model inputs are scaled from it
+	std::vector<std::shared_ptr<struct drm_buf> > model_bufs_;
+	DmaBufMapCache surface_maps_; // CPU mappings of decoder surfaces for the software path
+	YuvToRgbTables color_tables_; // software YUV -> BGR terms for the stream's matrix and range
 
 	// Hardware acceleration control
 	bool use_software_only = !ENABLE_RGA_HARDWARE;
@@ -91,6 +141,118 @@ class FFmpegStreamChannel {
 	std::unique_ptr<MJPEGStreamer> mjpeg_streamer_;
 	bool enable_mjpeg_streaming_ = true;
 
+	// Detection crops: one best shot per tracked person
+	std::unique_ptr<BestShotSaver> best_shot_saver_;
+	bool enable_best_shot_saving_ = true;
+	// Channels share the output directory; their files are told apart by this name
+	void set_best_shot_source(const std::string &name)
+	{
+		if (best_shot_saver_) {
+			best_shot_saver_->set_source_name(name);
+		}
+	}
+
+	// Tracking: the detector runs every Nth frame, tracks fill the frames in between
+	ObjectTracker tracker_;
+	void set_inference_interval(int frames)
+	{
+		tracker_.set_max_interval(frames);
+	}
+
+	// Motion gating: skip inference on static frames, heartbeat keeps it honest
+	MotionGate motion_gate_;
+	void set_motion_gate(bool enabled, float threshold = MOTION_THRESHOLD_DEFAULT, int heartbeat_ms = MOTION_HEARTBEAT_MS)
+	{
+		motion_gate_.set_enabled(enabled);
+		motion_gate_.set_threshold(threshold);
+		motion_gate_.set_heartbeat_ms(heartbeat_ms);
+	}
+
+	// Region of interest fed to the model, as fractions of the frame.
+	// The crop and the scale to model size happen in one RGA blit.
+	float roi_x_ = 0.f, roi_y_ = 0.f, roi_w_ = 1.f, roi_h_ = 1.f;
+	void set_roi(float x, float y, float w, float h);
+	BOX_RECT roi_rect(int src_w, int src_h) const;
+	void update_model_transform(ModelInputSlot *slot, int src_w, int src_h);
+
+	// Letterboxing keeps the crop's aspect ratio inside the model input
+	bool letterbox_ = LETTERBOX_DEFAULT;
+	std::map<const void *, BOX_RECT> padded_rects_; // content rect each input buffer was last padded for
+	void set_letterbox(bool enabled)
+	{
+		letterbox_ = enabled;
+	}
+	void layout_model_input(ModelInputSlot *slot) const;
+	int pad_model_input(size_t index, const ModelInputSlot &slot);
+
+	// Tiled inference: the ROI is split into overlapping tiles, each scaled into
+	// its own input buffer, with an optional full-frame pass on top
+	int tile_cols_ = 1, tile_rows_ = 1;
+	float tile_overlap_ = TILE_OVERLAP_DEFAULT;
+	bool tile_full_frame_pass_ = false;
+	std::vector<ModelInputSlot> model_inputs_;
+	std::vector<detect_result_t> tile_candidates_;
+	detect_result_group_t tile_detections_; // one tile's detections
+	void set_tiling(int cols, int rows, float overlap = TILE_OVERLAP_DEFAULT, bool full_frame_pass = false);
+	int build_model_inputs(int src_w, int src_h);
+
+	// Live mode: on network sources only the newest decoded frame is processed
+	bool live_mode_ = LIVE_MODE_DEFAULT;
+	LatestFrameSlot latest_frame_;
+	void set_live_mode(bool enabled)
+	{
+		live_mode_ = enabled;
+	}
+
+	// Decode policy: channels that infer rarely need not decode every frame.
+	// Decode-thread state except for the two atomics, which the processing thread writes/reads.
+	DecodePolicy decode_policy_ = DECODE_POLICY_AUTO;
+	DecodePolicy active_decode_policy_ = DECODE_POLICY_ALL;
+	std::atomic<int> inference_interval_hint_{ 1 };
+	std::atomic<bool> keyframes_only_{ false };
+	int gop_length_ = 0;
+	int packets_since_key_ = 0;
+	long long skipped_packets_ = 0;
+	void set_decode_policy(DecodePolicy policy)
+	{
+		decode_policy_ = policy;
+	}
+	DecodePolicy choose_decode_policy() const;
+	bool apply_decode_policy(const AVPacket *packet);
+
+	// The tracker counts source frames, derived from pts, so its interval does not
+	// stretch when the decode policy or live mode leaves frames out. Processing-thread state.
+	int64_t source_frame_duration_ = 0; // stream time base units, 0 if unknown
+	int64_t last_source_pts_ = AV_NOPTS_VALUE;
+	int source_frames_elapsed(const AVFrame *frame);
+
+	// File looping: seek back to the start at EOF, keeping every context alive.
+	// Timestamps are shifted by the length of the passes before so they stay monotonic.
+	bool loop_files_ = FILE_LOOP_DEFAULT;
+	int64_t pts_offset_ = 0;
+	int64_t pass_start_pts_ = 0;
+	int64_t pass_end_pts_ = 0;
+	void set_file_looping(bool enabled)
+	{
+		loop_files_ = enabled;
+	}
+	int receive_frames(AVFrame *frame, bool live);
+
+	// Stream open: probing profile, and an input already opened by the caller for the first session
+	std::string open_profile_ = OPEN_PROFILE_DEFAULT;
+	AVFormatContext *prefetched_input_ = nullptr;
+	void set_open_profile(const std::string &profile)
+	{
+		open_profile_ = profile;
+	}
+	void adopt_input(AVFormatContext *input)
+	{
+		if (prefetched_input_) {
+			avformat_close_input(&prefetched_input_);
+		}
+		prefetched_input_ = input;
+	}
+
 	bool decode(const char *);
 	bool decode_continuous(const char *);
 	void stop_processing();
@@ -102,36 +264,44 @@ class FFmpegStreamChannel {
 	/* rknn */
 	const float nms_threshold = NMS_THRESH;
 	const float box_conf_threshold = BOX_THRESH;
-	rknn_context rknn_ctx;
+	rknn_context rknn_ctx = 0;
 	int rknn_input_channel = 3;
 	int rknn_input_width = 0;
 	int rknn_input_height = 0;
 	rknn_input inputs[1];
 	rknn_input_output_num io_num;
 	rknn_tensor_attr *output_attrs;
+	RknnOutputWorkspace output_workspace_; // outputs of rknn_ctx, sized once in init_rknn2
 	int init_rga_drm();
-	int init_rknn2();
+	std::unique_ptr<DetectionDecoder> decoder_;
+
+	// Optional cross-channel batching; without a broker the channel runs its own context
+	std::shared_ptr<InferenceBroker> broker_;
+	std::vector<std::vector<int8_t> > broker_outputs_;
+	std::vector<uint8_t> packed_input_; // model input with the row padding removed, when the allocator padded it
+	const void *packed_model_input(const ModelInputSlot &model_input);
+	std::vector<int8_t *> broker_output_ptrs_;
+	void set_inference_broker(std::shared_ptr<InferenceBroker> broker);
+
+	// Optional NPU arbitration between channels (priority, target fps, deadline)
+	std::shared_ptr<NpuScheduler> npu_scheduler_;
+	int npu_sched_id_ = -1;
+	void set_npu_scheduler(std::shared_ptr<NpuScheduler> scheduler, const std::string &name, float weight = NPU_SCHED_DEFAULT_WEIGHT,
+			       float target_fps = NPU_SCHED_DEFAULT_FPS, int deadline_ms = NPU_SCHED_DEFAULT_DEADLINE_MS);
+	int init_rknn2(const ModelConfig &model);
+	int apply_class_filter(const std::string &classes);
+	void warm_up_model();
 
 	// Hardware acceleration helper functions
-	int process_frame_hardware(int fd, int src_w, int src_h, int src_pitch);
-	int process_frame_software_fallback(AVFrame* frame, int src_w, int src_h, int src_pitch);
-	void yuv420p_to_rgb888(const uint8_t* yuv_data, uint8_t* rgb_data, int width, int height);
-	void yuv420p_to_bgr888(const uint8_t* yuv_data, uint8_t* bgr_data, int width, int height);
-	void nv12_to_rgb888(const uint8_t* nv12_data, uint8_t* rgb_data, int width, int height);
-	void nv12_to_bgr888(const uint8_t* nv12_data, uint8_t* bgr_data, int width, int height);
-
-	// Stride-aware conversion functions for proper pitch handling
-	void nv12_to_rgb888_stride(const uint8_t* nv12_data, uint8_t* rgb_data, int width, int height, int stride);
-	void nv12_to_bgr888_stride(const uint8_t* nv12_data, uint8_t* bgr_data, int width, int height, int stride);
-	void yuv420p_to_rgb888_stride(const uint8_t* yuv_data, uint8_t* rgb_data, int width, int height, int stride);
-	void yuv420p_to_bgr888_stride(const uint8_t* yuv_data, uint8_t* bgr_data, int width, int height, int stride);
-
-	// RKNN-specific BGR conversion functions
-	void nv12_to_bgr888_stride_rknn(const uint8_t* nv12_data, uint8_t* bgr_data, int width, int height, int stride);
-	void yuv420p_to_bgr888_stride_rknn(const uint8_t* yuv_data, uint8_t* bgr_data, int width, int height, int stride);
-
-	bool check_rkmpp_decoder_availability(const char* decoder_name);
-	bool validate_hardware_acceleration();
+	int process_frame_hardware(const FrameDesc &desc, ModelInputSlot *model_input, bool need_display_output);
+	int process_frame_software_fallback(AVFrame *frame, const FrameDesc &desc, ModelInputSlot *model_input, bool need_display_output);
+	int prepare_frame(AVFrame *frame, const FrameDesc &desc, ModelInputSlot *model_input, bool need_display_output);
+	bool model_input_from_display(ModelInputSlot *model_input, int src_w, int src_h);
+	int run_inference(const ModelInputSlot &model_input, detect_result_group_t *group);
+	int run_model_inputs(AVFrame *frame, const FrameDesc &desc, detect_result_group_t *group);
+	// received_us: when the decoder handed the frame over, the age the NPU deadline is measured from
+	int process_decoded_frame(AVFrame *frame, long long received_us);
+	detect_result_group_t detections_; // the current frame's detections, reused between frames
 
 	// MJPEG streaming methods
 	int init_mjpeg_streaming(int port = 8090);
@@ -147,7 +317,7 @@ class FFmpegStreamChannel {
 	int init_window();
 	void bind_cv_mat_to_gl_texture(cv::Mat& image, GLuint& imageTexture);
 
-	FFmpegStreamChannel()
+	explicit FFmpegStreamChannel(const ModelConfig &model = ModelConfig())
 	{
 		printf("DEBUG: Starting FFmpegStreamChannel constructor\n");
 		printf("DEBUG: Initial dimensions - display: %dx%d, rknn: %dx%d\n",
@@ -171,9 +341,21 @@ class FFmpegStreamChannel {
 		printf("DEBUG: init_rga_drm() completed\n");
 
 		printf("DEBUG: Calling init_rknn2()\n");
-		init_rknn2();
+		init_rknn2(model);
 		printf("DEBUG: init_rknn2() completed\n");
 
+		if (enable_best_shot_saving_) {
+			best_shot_saver_.reset(new BestShotSaver());
+			int class_id = decoder_ ? decoder_->class_id(best_shot_saver_->class_name().c_str()) : -1;
+			if (class_id < 0 || !decoder_->detects(class_id)) {
+				printf("WARNING: class '%s' is not detected by this channel, best shot saving disabled\n",
+				       best_shot_saver_->class_name().c_str());
+				best_shot_saver_.reset();
+			} else {
+				best_shot_saver_->set_class_id(class_id);
+			}
+		}
+
 		printf("DEBUG: Calling init_window()\n");
 		init_window();
 		printf("DEBUG: init_window() completed\n");
@@ -201,6 +383,10 @@ class FFmpegStreamChannel {
 	{
 		stop_mjpeg_streaming();
 		cleanup_ffmpeg_contexts();
+		adopt_input(nullptr);
+		if (rknn_ctx) {
+			rknn_destroy(rknn_ctx);
+		}
 		if (output_attrs) {
 			free(output_attrs);
 			output_attrs = nullptr;
@@ -0,0 +1,149 @@
+#include "frame_desc.h"
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavutil/hwcontext_drm.h>
+#ifdef __cplusplus
+}
+#endif
+
+#include "libdrm/drm_fourcc.h"
+#include "rga_func.h"
+#include "dma_frame_alloc.h"
+
+// Streams that do not signal a matrix follow the usual convention: SD is BT.601, HD is BT.709
+static YuvMatrix frame_matrix(const AVFrame *frame)
+{
+	switch (frame->colorspace) {
+	case AVCOL_SPC_BT709:
+		return YUV_MATRIX_BT709;
+	case AVCOL_SPC_BT470BG:
+	case AVCOL_SPC_SMPTE170M:
+	case AVCOL_SPC_FCC:
+	case AVCOL_SPC_SMPTE240M:
+		return YUV_MATRIX_BT601;
+	default:
+		// BT.2020 content is converted with BT.709, the nearest supported matrix
+		return frame->height >= 720 ? YUV_MATRIX_BT709 : YUV_MATRIX_BT601;
+	}
+}
+
+static bool frame_full_range(const AVFrame *frame)
+{
+	if (frame->color_range == AVCOL_RANGE_JPEG) {
+		return true;
+	}
+	if (frame->color_range == AVCOL_RANGE_MPEG) {
+		return false;
+	}
+	return frame->format == AV_PIX_FMT_YUVJ420P;
+}
+
+static int describe_drm_frame(const AVFrame *frame, FrameDesc *desc)
+{
+	const AVDRMFrameDescriptor *drm = reinterpret_cast<const AVDRMFrameDescriptor *>(frame->data[0]);
+	if (!drm || drm->nb_objects < 1 || drm->nb_layers < 1 || drm->layers[0].nb_planes < 1 || drm->objects[0].fd < 0) {
+		printf("Invalid DRM PRIME frame descriptor\n");
+		return -1;
+	}
+	const AVDRMLayerDescriptor &layer = drm->layers[0];
+	desc->fd = drm->objects[0].fd;
+	desc->pitch = layer.planes[0].pitch > 0 ? (int)layer.planes[0].pitch : frame->width;
+
+	switch (layer.format) {
+	case DRM_FORMAT_NV12:
+		desc->rga_format = RK_FORMAT_YCbCr_420_SP;
+		break;
+	case DRM_FORMAT_NV21:
+		desc->rga_format = RK_FORMAT_YCrCb_420_SP;
+		break;
+	case 0:
+		// rkmpp may leave the fourcc unset; its two-plane output is NV12
+		desc->rga_format = layer.nb_planes == 2 ? RK_FORMAT_YCbCr_420_SP : -1;
+		break;
+	default:
+		desc->rga_format = -1;
+		break;
+	}
+
+	// rkmpp pads the luma plane to its vertical stride (1088 rows for 1080p)
+	desc->vstride = frame->height;
+	if (layer.nb_planes > 1 && desc->pitch > 0 && layer.planes[1].offset % desc->pitch == 0 &&
+	    (int)(layer.planes[1].offset / desc->pitch) >= frame->height) {
+		desc->vstride = layer.planes[1].offset / desc->pitch;
+	}
+	// A single-plane NV12 layer keeps chroma after the padded luma rows; rkmpp aligns them to 16
+	int aligned = (frame->height + 15) & ~15;
+	if (layer.nb_planes == 1 && drm->objects[0].size >= layer.planes[0].offset + (size_t)desc->pitch * aligned * 3 / 2) {
+		desc->vstride = aligned;
+	}
+	return 0;
+}
+
+int describe_frame(const AVFrame *frame, FrameDesc *desc)
+{
+	desc->width = frame->width;
+	desc->height = frame->height;
+	desc->matrix = frame_matrix(frame);
+	desc->full_range = frame_full_range(frame);
+
+	if (frame->format == AV_PIX_FMT_DRM_PRIME) {
+		return describe_drm_frame(frame, desc);
+	}
+	if (!frame->data[0]) {
+		return -1;
+	}
+
+	desc->pitch = frame->linesize[0];
+	desc->vstride = frame->height;
+	desc->fd = -1;
+	desc->rga_format = -1;
+	// Software frames decoded into pool buffers can be read by RGA. RGA reads from the start of
+	// the buffer, so a frame whose planes were cropped from the top or left takes the copy path.
+	const DmaFrameInfo *dma = dma_frame_info(frame);
+	if (dma && frame->data[0] == dma->luma && !frame->crop_left && !frame->crop_top) {
+		desc->fd = dma->fd;
+		desc->vstride = dma->vstride;
+		desc->rga_format = dma->rga_format;
+	}
+	return 0;
+}
+
+const char *yuv_matrix_name(YuvMatrix matrix)
+{
+	return matrix == YUV_MATRIX_BT709 ? "BT.709" : "BT.601";
+}
+
+int rga_color_space_mode(const FrameDesc &desc)
+{
+	if (desc.matrix == YUV_MATRIX_BT709) {
+		return RGA_YUV_TO_RGB_BT709_LIMIT;
+	}
+	return desc.full_range ? RGA_YUV_TO_RGB_BT601_FULL : RGA_YUV_TO_RGB_BT601_LIMIT;
+}
+
+void YuvToRgbTables::build(YuvMatrix m, bool full)
+{
+	matrix = m;
+	full_range = full;
+
+	// Kr/Kb define the matrix; the rest follows
+	double kr = m == YUV_MATRIX_BT709 ? 0.2126 : 0.299;
+	double kb = m == YUV_MATRIX_BT709 ? 0.0722 : 0.114;
+	double kg = 1.0 - kr - kb;
+	double y_scale = full ? 1.0 : 255.0 / 219.0;
+	double c_scale = full ? 1.0 : 255.0 / 224.0;
+	int y_offset = full ? 0 : 16;
+
+	for (int i = 0; i < 256; i++) {
+		double c = (i - 128) * c_scale;
+		y[i] = (int)((i - y_offset) * y_scale * 65536.0 + 0.5);
+		v_r[i] = (int)(2.0 * (1.0 - kr) * c * 65536.0);
+		u_g[i] = (int)(-2.0 * (1.0 - kb) * kb / kg * c * 65536.0);
+		v_g[i] = (int)(-2.0 * (1.0 - kr) * kr / kg * c * 65536.0);
+		u_b[i] = (int)(2.0 * (1.0 - kb) * c * 65536.0);
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef __FRAME_DESC_H__
+#define __FRAME_DESC_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavutil/frame.h>
+#ifdef __cplusplus
+}
+#endif
+
+enum YuvMatrix {
+	YUV_MATRIX_BT601,
+	YUV_MATRIX_BT709,
+};
+
+// What the pipeline needs to know about a decoded frame, decided once from
+// what the decoder reports rather than guessed from pixel values.
+struct FrameDesc {
+	int fd; // dma-buf holding the planes, -1 when only the CPU can read them
+	int width; // visible size
+	int height;
+	int pitch; // luma row bytes
+	int vstride; // luma rows before the chroma plane
+	int rga_format; // RK_FORMAT_* of the planes, -1 if RGA cannot read them
+	YuvMatrix matrix;
+	bool full_range;
+};
+
+// Fill desc from the frame's format, color_range/colorspace and, for DRM
+// PRIME frames, the layer fourcc and plane layout. Returns 0, or -1 for
+// frames without usable planes.
+int describe_frame(const AVFrame *frame, FrameDesc *desc);
+
+const char *yuv_matrix_name(YuvMatrix matrix);
+
+// rga_info_t.color_space_mode for the frame. RGA has no BT.709 full-range
+// mode; those frames get BT.709 limited, the closest it offers.
+int rga_color_space_mode(const FrameDesc &desc);
+
+// Fixed-point (16.16) YUV to RGB terms for one matrix and range, indexed
+// by the 8-bit sample, so per-pixel conversion is table lookups and adds.
+struct YuvToRgbTables {
+	YuvMatrix matrix;
+	bool full_range;
+	int y[256];
+	int v_r[256];
+	int u_g[256];
+	int v_g[256];
+	int u_b[256];
+
+	YuvToRgbTables() : matrix(YUV_MATRIX_BT601), full_range(false)
+	{
+		build(YUV_MATRIX_BT601, false);
+	}
+	// Rebuilds only when the stream's color description changes
+	void configure(const FrameDesc &desc)
+	{
+		if (desc.matrix != matrix || desc.full_range != full_range) {
+			build(desc.matrix, desc.full_range);
+		}
+	}
+	void build(YuvMatrix matrix, bool full_range);
+};
+
+#endif
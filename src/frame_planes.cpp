@@ -0,0 +1,120 @@
+#include "frame_planes.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "libdrm/drm_fourcc.h"
+
+int frame_planes_from_avframe(const AVFrame *frame, int width, int height, FramePlanes *planes)
+{
+	planes->width = width;
+	planes->height = height;
+	planes->y_stride = frame->linesize[0];
+	planes->uv_stride = frame->linesize[1];
+
+	switch (frame->format) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+		if (frame->linesize[1] != frame->linesize[2]) {
+			printf("Error: YUV420P frame with unequal chroma strides (%d, %d)\n", frame->linesize[1], frame->linesize[2]);
+			return -1;
+		}
+		planes->y = frame->data[0];
+		planes->u = frame->data[1];
+		planes->v = frame->data[2];
+		planes->y_step = 1;
+		planes->uv_step = 1;
+		return 0;
+	case AV_PIX_FMT_NV12:
+	case AV_PIX_FMT_NV21: {
+		bool vu = frame->format == AV_PIX_FMT_NV21;
+		planes->y = frame->data[0];
+		planes->u = frame->data[1] + (vu ? 1 : 0);
+		planes->v = frame->data[1] + (vu ? 0 : 1);
+		planes->y_step = 1;
+		planes->uv_step = 2;
+		return 0;
+	}
+	case AV_PIX_FMT_P010LE:
+		// 10 bits in the top of little-endian 16-bit words: the odd byte holds the 8 MSBs
+		planes->y = frame->data[0] + 1;
+		planes->u = frame->data[1] + 1;
+		planes->v = frame->data[1] + 3;
+		planes->y_step = 2;
+		planes->uv_step = 4;
+		return 0;
+	default:
+		printf("Error: Unsupported frame format for software processing: %d\n", frame->format);
+		return -1;
+	}
+}
+
+int frame_planes_from_drm(const AVDRMFrameDescriptor *desc, const uint8_t *base, int width, int height, int vstride,
+			  FramePlanes *planes)
+{
+	if (desc->nb_layers < 1 || desc->layers[0].nb_planes < 1) {
+		printf("Error: DRM frame without planes\n");
+		return -1;
+	}
+	const AVDRMLayerDescriptor &layer = desc->layers[0];
+	// rkmpp may leave the layer format unset; its two-plane output is NV12
+	bool unset_nv12 = layer.format == 0 && layer.nb_planes == 2;
+	if (layer.format != DRM_FORMAT_NV12 && layer.format != DRM_FORMAT_NV21 && !unset_nv12) {
+		printf("Error: Unsupported DRM layer format 0x%08x for software processing\n", layer.format);
+		return -1;
+	}
+	for (int i = 0; i < layer.nb_planes; i++) {
+		if (layer.planes[i].object_index != 0) {
+			printf("Error: DRM frame with planes in separate objects\n");
+			return -1;
+		}
+	}
+
+	// Some exporters describe NV12 as a single plane with chroma right after the padded luma rows
+	int pitch = (int)layer.planes[0].pitch;
+	const uint8_t *uv = layer.nb_planes > 1 ? base + layer.planes[1].offset : base + layer.planes[0].offset + (size_t)pitch * vstride;
+	bool vu = layer.format == DRM_FORMAT_NV21;
+	planes->y = base + layer.planes[0].offset;
+	planes->u = uv + (vu ? 1 : 0);
+	planes->v = uv + (vu ? 0 : 1);
+	planes->y_stride = pitch;
+	planes->uv_stride = layer.nb_planes > 1 ? (int)layer.planes[1].pitch : pitch;
+	planes->y_step = 1;
+	planes->uv_step = 2;
+	planes->width = width;
+	planes->height = height;
+	return 0;
+}
+
+void frame_planes_to_bgr888(const FramePlanes &src, const YuvToRgbTables &tables, const BOX_RECT &crop, uint8_t *dst_data,
+			    int dst_pitch, const BOX_RECT &dst)
+{
+	// Only the crop rectangle is scaled, into the dst rectangle
+	float scale_x = (float)(crop.right - crop.left) / (dst.right - dst.left);
+	float scale_y = (float)(crop.bottom - crop.top) / (dst.bottom - dst.top);
+
+	for (int dst_y = dst.top; dst_y < dst.bottom; dst_y++) {
+		int src_y = std::min(crop.top + (int)((dst_y - dst.top) * scale_y), src.height - 1);
+		const uint8_t *y_row = src.y + (size_t)src_y * src.y_stride;
+		const uint8_t *u_row = src.u + (size_t)(src_y / 2) * src.uv_stride;
+		const uint8_t *v_row = src.v + (size_t)(src_y / 2) * src.uv_stride;
+		uint8_t *out = dst_data + (size_t)dst_y * dst_pitch + (size_t)dst.left * 3;
+
+		for (int dst_x = dst.left; dst_x < dst.right; dst_x++) {
+			int src_x = std::min(crop.left + (int)((dst_x - dst.left) * scale_x), src.width - 1);
+
+			int yy = tables.y[y_row[src_x * src.y_step]];
+			int u = u_row[(src_x / 2) * src.uv_step];
+			int v = v_row[(src_x / 2) * src.uv_step];
+
+			int r = (yy + tables.v_r[v]) >> 16;
+			int g = (yy + tables.u_g[u] + tables.v_g[v]) >> 16;
+			int b = (yy + tables.u_b[u]) >> 16;
+
+			out[0] = (uint8_t)std::max(0, std::min(255, b)); // BGR format: Blue first
+			out[1] = (uint8_t)std::max(0, std::min(255, g));
+			out[2] = (uint8_t)std::max(0, std::min(255, r));
+			out += 3;
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef __FRAME_PLANES_H__
+#define __FRAME_PLANES_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavutil/frame.h>
+#include <libavutil/hwcontext_drm.h>
+#ifdef __cplusplus
+}
+#endif
+
+#include "yolov5s_postprocess.h"
+#include "frame_desc.h"
+
+// A 4:2:0 image as the CPU reads it, straight from the decoder's memory.
+//
+// Every supported layout reduces to three byte pointers with a row stride
+// and a step between samples: planar formats step 1, interleaved chroma
+// steps 2 with v = u + 1 (or u = v + 1 for NV21), and P010 reads the high
+// byte of each 16-bit sample. Converters therefore need no per-format code
+// and nothing is repacked before conversion.
+struct FramePlanes {
+	const uint8_t *y;
+	const uint8_t *u;
+	const uint8_t *v;
+	int y_stride; // bytes per row
+	int uv_stride;
+	int y_step; // bytes between horizontally adjacent samples
+	int uv_step;
+	int width;
+	int height;
+};
+
+// Software frames: YUV420P, YUVJ420P, NV12, NV21, P010. Returns 0, or -1 for other formats.
+int frame_planes_from_avframe(const AVFrame *frame, int width, int height, FramePlanes *planes);
+
+// DRM PRIME frames whose first object is mapped at base (NV12 / NV21 layers).
+// vstride is the number of luma rows before chroma when the layer has one plane.
+int frame_planes_from_drm(const AVDRMFrameDescriptor *desc, const uint8_t *base, int width, int height, int vstride,
+			  FramePlanes *planes);
+
+// Scale the crop rectangle of src into the dst rectangle of a BGR888 image
+// whose rows are dst_pitch bytes apart, with the matrix and range tables describes.
+void frame_planes_to_bgr888(const FramePlanes &src, const YuvToRgbTables &tables, const BOX_RECT &crop, uint8_t *dst_data,
+			    int dst_pitch, const BOX_RECT &dst);
+
+#endif
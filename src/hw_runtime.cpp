@@ -0,0 +1,218 @@
+#include "hw_runtime.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#ifdef __cplusplus
+}
+#endif
+
+#include "config.h"
+
+static bool check_rkmpp_decoder_availability(const char *decoder_name)
+{
+	printf("Checking decoder: %s\n", decoder_name);
+
+	AVCodec* decoder = avcodec_find_decoder_by_name(decoder_name);
+	if (!decoder) {
+		printf("❌ RKMPP decoder %s not found\n", decoder_name);
+		return false;
+	}
+
+	printf("✅ Decoder %s found (type: %s)\n", decoder_name,
+		   decoder->type == AVMEDIA_TYPE_VIDEO ? "video" : "other");
+
+	// Check if decoder supports DRM PRIME format
+	bool drm_prime_supported = false;
+	bool nv12_supported = false;
+	int format_count = 0;
+
+	printf("   Supported pixel formats: ");
+	if (decoder->pix_fmts) {
+		for (int i = 0; decoder->pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
+			format_count++;
+			const char* fmt_name = av_get_pix_fmt_name(decoder->pix_fmts[i]);
+			printf("%s ", fmt_name ? fmt_name : "unknown");
+
+			if (decoder->pix_fmts[i] == AV_PIX_FMT_DRM_PRIME) {
+				drm_prime_supported = true;
+			} else if (decoder->pix_fmts[i] == AV_PIX_FMT_NV12) {
+				nv12_supported = true;
+			}
+		}
+	} else {
+		printf("(format list not available)");
+	}
+	printf("\n");
+
+	printf("   Format support: DRM_PRIME=%s, NV12=%s, total_formats=%d\n",
+		   drm_prime_supported ? "YES" : "NO",
+		   nv12_supported ? "YES" : "NO",
+		   format_count);
+
+	return true;
+}
+
+static bool validate_hardware_acceleration()
+{
+	printf("=== Validating Hardware Acceleration Capabilities ===\n");
+
+	// Check DRM device access
+	printf("Checking DRM device access...\n");
+	int test_fd = open("/dev/dri/card0", O_RDWR);
+	if (test_fd < 0) {
+		printf("❌ Cannot access /dev/dri/card0: %s\n", strerror(errno));
+		return false;
+	}
+	close(test_fd);
+	printf("✅ DRM device accessible\n");
+
+	// Check RGA library availability
+	printf("Checking RGA library availability...\n");
+	void* rga_handle = dlopen("/usr/lib/aarch64-linux-gnu/librga.so", RTLD_LAZY);
+	if (!rga_handle) {
+		printf("❌ RGA library not found: %s\n", dlerror());
+		return false;
+	}
+
+	// Check for required RGA functions
+	void* init_func = dlsym(rga_handle, "c_RkRgaInit");
+	void* blit_func = dlsym(rga_handle, "c_RkRgaBlit");
+	void* deinit_func = dlsym(rga_handle, "c_RkRgaDeInit");
+
+	if (!init_func || !blit_func || !deinit_func) {
+		printf("❌ Required RGA functions not found\n");
+		dlclose(rga_handle);
+		return false;
+	}
+
+	dlclose(rga_handle);
+	printf("✅ RGA library and functions available\n");
+
+	// Check RKNN library availability
+	printf("Checking RKNN library availability...\n");
+	void* rknn_handle = dlopen("/lib/librknnrt.so", RTLD_LAZY);
+	if (!rknn_handle) {
+		// Try alternative location
+		rknn_handle = dlopen("/usr/lib/aarch64-linux-gnu/librknnrt.so", RTLD_LAZY);
+		if (!rknn_handle) {
+			// Try system search
+			rknn_handle = dlopen("librknnrt.so", RTLD_LAZY);
+			if (!rknn_handle) {
+				printf("❌ RKNN library not found: %s\n", dlerror());
+				printf("   Tried: /lib/librknnrt.so, /usr/lib/aarch64-linux-gnu/librknnrt.so, librknnrt.so\n");
+				return false;
+			}
+		}
+	}
+	dlclose(rknn_handle);
+	printf("✅ RKNN library available\n");
+
+	printf("=== Hardware Acceleration Validation Complete ===\n");
+	return true;
+}
+
+HardwareRuntime &HardwareRuntime::instance()
+{
+	static HardwareRuntime runtime;
+	return runtime;
+}
+
+HardwareRuntime::~HardwareRuntime()
+{
+	for (auto &it : models_) {
+		if (it.second.master) {
+			rknn_destroy(it.second.master);
+		}
+		if (it.second.data) {
+			munmap(it.second.data, it.second.size);
+		}
+	}
+}
+
+bool HardwareRuntime::hardware_available()
+{
+	std::call_once(validate_once_, [this] {
+		printf("=== Hardware Acceleration Startup Validation ===\n");
+		hardware_available_ = validate_hardware_acceleration();
+		if (!hardware_available_) {
+			return;
+		}
+
+		printf("=== Checking RKMPP decoder availability ===\n");
+		check_rkmpp_decoder_availability("h264_rkmpp");
+		check_rkmpp_decoder_availability("hevc_rkmpp");
+		check_rkmpp_decoder_availability("av1_rkmpp");
+		check_rkmpp_decoder_availability("vp9_rkmpp");
+		printf("=== RKMPP decoder check completed ===\n");
+	});
+	return hardware_available_;
+}
+
+int HardwareRuntime::load_locked(const std::string &model_path, Model *model)
+{
+	int fd = open(model_path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		printf("Open file %s failed.\n", model_path.c_str());
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		printf("Model file %s is empty or unreadable\n", model_path.c_str());
+		close(fd);
+		return -1;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		printf("mmap of %s failed: %s\n", model_path.c_str(), strerror(errno));
+		return -1;
+	}
+
+	int ret = rknn_init(&model->master, data, st.st_size, 0, NULL);
+	if (ret < 0) {
+		printf("rknn_init error ret=%d\n", ret);
+		munmap(data, st.st_size);
+		return -1;
+	}
+	model->data = data;
+	model->size = st.st_size;
+	printf("Model %s mapped (%zu bytes) and initialised once for all channels\n", model_path.c_str(), model->size);
+	return 0;
+}
+
+int HardwareRuntime::create_context(const std::string &model_path, rknn_context *ctx)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = models_.find(model_path);
+	if (it == models_.end()) {
+		Model model;
+		if (load_locked(model_path, &model) != 0) {
+			return -1;
+		}
+		it = models_.insert(std::make_pair(model_path, model)).first;
+	}
+
+	// Duplicates share the master's weights; the master itself stays with the runtime
+	int ret = rknn_dup_context(&it->second.master, ctx);
+	if (ret < 0) {
+		printf("rknn_dup_context failed (%d), loading %s again\n", ret, model_path.c_str());
+		ret = rknn_init(ctx, it->second.data, it->second.size, 0, NULL);
+		if (ret < 0) {
+			printf("rknn_init error ret=%d\n", ret);
+			return -1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef __HW_RUNTIME_H__
+#define __HW_RUNTIME_H__
+
+#include <stddef.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "rknn_api.h"
+
+// Process-wide hardware state shared by every channel.
+//
+// Hardware validation (device node, librga, librknnrt, rkmpp decoders) runs
+// once per process. Each model file is memory-mapped read-only once and
+// initialised into one master context; channels get their own context via
+// rknn_dup_context, which shares the weights instead of loading them again.
+class HardwareRuntime {
+    public:
+	static HardwareRuntime &instance();
+
+	// Result of the one-time validation; later calls return it without probing again.
+	bool hardware_available();
+
+	// New context for the model at path. Thread-safe. Returns 0 or -1.
+	int create_context(const std::string &model_path, rknn_context *ctx);
+
+    private:
+	HardwareRuntime() {}
+	~HardwareRuntime();
+
+	struct Model {
+		void *data = nullptr;
+		size_t size = 0;
+		rknn_context master = 0;
+	};
+
+	std::once_flag validate_once_;
+	bool hardware_available_ = false;
+
+	std::mutex mutex_;
+	std::map<std::string, Model> models_;
+
+	int load_locked(const std::string &model_path, Model *model);
+};
+
+#endif
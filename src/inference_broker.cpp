@@ -0,0 +1,240 @@
+#include "inference_broker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "config.h"
+#include "hw_runtime.h"
+#include "rknn_utils.h"
+
+RknnBatchBackend::RknnBatchBackend()
+{
+}
+
+RknnBatchBackend::~RknnBatchBackend()
+{
+	if (initialized_) {
+		rknn_destroy(ctx_);
+	}
+}
+
+int RknnBatchBackend::init(const char *model_path)
+{
+	int ret = HardwareRuntime::instance().create_context(model_path, &ctx_);
+	if (ret < 0) {
+		printf("Batch backend: failed to load %s\n", model_path);
+		return -1;
+	}
+	initialized_ = true;
+
+	rknn_input_output_num io_num;
+	ret = rknn_query(ctx_, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
+	if (ret < 0 || io_num.n_input != 1) {
+		printf("Batch backend: unsupported model (ret=%d, inputs=%d)\n", ret, io_num.n_input);
+		return -1;
+	}
+
+	rknn_tensor_attr input_attr;
+	memset(&input_attr, 0, sizeof(input_attr));
+	input_attr.index = 0;
+	ret = rknn_query(ctx_, RKNN_QUERY_INPUT_ATTR, &input_attr, sizeof(input_attr));
+	if (ret < 0) {
+		printf("Batch backend: input query failed ret=%d\n", ret);
+		return -1;
+	}
+	dump_tensor_attr(&input_attr);
+
+	// Outermost input dimension is the batch
+	batch_ = input_attr.dims[0] > 0 ? input_attr.dims[0] : 1;
+	sample_input_size_ = input_attr.n_elems / batch_;
+	input_.resize(sample_input_size_ * batch_);
+
+	output_attrs_.resize(io_num.n_output);
+	sample_output_size_.resize(io_num.n_output);
+	for (uint32_t i = 0; i < io_num.n_output; i++) {
+		memset(&output_attrs_[i], 0, sizeof(rknn_tensor_attr));
+		output_attrs_[i].index = i;
+		rknn_query(ctx_, RKNN_QUERY_OUTPUT_ATTR, &output_attrs_[i], sizeof(rknn_tensor_attr));
+		dump_tensor_attr(&output_attrs_[i]);
+		sample_output_size_[i] = output_attrs_[i].n_elems / batch_;
+	}
+	if (outputs_.init(output_attrs_.data(), io_num.n_output) != 0) {
+		return -1;
+	}
+
+	printf("Batch backend: %s, batch=%d, %zu input bytes per sample\n", model_path, batch_, sample_input_size_);
+	return 0;
+}
+
+int RknnBatchBackend::run(const void *const *inputs, int count, std::vector<std::vector<int8_t> > *const *outputs)
+{
+	// Samples are packed back to back; unused slots of a partial batch keep stale data
+	for (int s = 0; s < count; s++) {
+		memcpy(input_.data() + s * sample_input_size_, inputs[s], sample_input_size_);
+	}
+
+	rknn_input input;
+	memset(&input, 0, sizeof(input));
+	input.index = 0;
+	input.type = RKNN_TENSOR_UINT8;
+	input.fmt = RKNN_TENSOR_NHWC;
+	input.buf = input_.data();
+	input.size = input_.size();
+	int ret = rknn_inputs_set(ctx_, 1, &input);
+	if (ret < 0) {
+		printf("Batch backend: rknn_inputs_set failed: %d\n", ret);
+		return -1;
+	}
+
+	ret = rknn_run(ctx_, NULL);
+	if (ret < 0) {
+		printf("Batch backend: rknn_run failed: %d\n", ret);
+		return -1;
+	}
+
+	int n_output = output_attrs_.size();
+	if (outputs_.fetch(ctx_) < 0) {
+		return -1;
+	}
+
+	// Scatter: sample s owns the s-th slice of every output tensor
+	for (int s = 0; s < count; s++) {
+		outputs[s]->resize(n_output);
+		for (int o = 0; o < n_output; o++) {
+			const int8_t *src = outputs_.buffers()[o] + s * sample_output_size_[o];
+			(*outputs[s])[o].assign(src, src + sample_output_size_[o]);
+		}
+	}
+	return 0;
+}
+
+MockInferenceBackend::MockInferenceBackend(int batch, size_t input_size, const rknn_tensor_attr *output_attrs, int num_outputs, int call_us,
+					   int sample_us)
+	: batch_(batch), input_size_(input_size), call_us_(call_us), sample_us_(sample_us),
+	  output_attrs_(output_attrs, output_attrs + num_outputs)
+{
+	for (auto &attr : output_attrs_) {
+		attr.dims[0] = batch_;
+	}
+}
+
+int MockInferenceBackend::run(const void *const *inputs, int count, std::vector<std::vector<int8_t> > *const *outputs)
+{
+	(void)inputs;
+	std::this_thread::sleep_for(std::chrono::microseconds(call_us_ + sample_us_ * count));
+
+	for (int s = 0; s < count; s++) {
+		outputs[s]->resize(output_attrs_.size());
+		for (size_t o = 0; o < output_attrs_.size(); o++) {
+			// The zero point dequantizes to 0.0, which no decoder treats as a detection
+			const rknn_tensor_attr &attr = output_attrs_[o];
+			(*outputs[s])[o].assign(attr.n_elems, (int8_t)attr.zp);
+		}
+	}
+	return 0;
+}
+
+InferenceBroker::InferenceBroker(std::unique_ptr<InferenceBackend> backend, int max_wait_us)
+	: backend_(std::move(backend)), max_wait_us_(max_wait_us)
+{
+	worker_ = std::thread(&InferenceBroker::worker_loop, this);
+}
+
+InferenceBroker::~InferenceBroker()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	pending_cv_.notify_all();
+	if (worker_.joinable()) {
+		worker_.join();
+	}
+}
+
+int InferenceBroker::infer(const void *input, std::vector<std::vector<int8_t> > &outputs)
+{
+	Request req;
+	req.input = input;
+	req.outputs = &outputs;
+	req.enqueue_us = current_timestamp();
+	req.done = false;
+	req.ret = -1;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (stop_) {
+		return -1;
+	}
+	pending_.push_back(&req);
+	pending_cv_.notify_one();
+	done_cv_.wait(lock, [&req] { return req.done; });
+	return req.ret;
+}
+
+void InferenceBroker::worker_loop()
+{
+	int batch = backend_->batch_size();
+	std::vector<Request *> running;
+	std::vector<const void *> inputs;
+	std::vector<std::vector<std::vector<int8_t> > *> outputs;
+
+	while (true) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		pending_cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+		if (stop_) {
+			// Nobody may stay blocked in infer()
+			for (auto *req : pending_) {
+				req->done = true;
+			}
+			pending_.clear();
+			done_cv_.notify_all();
+			return;
+		}
+
+		// Hold the batch open until it fills or the oldest request runs out of patience
+		auto deadline = std::chrono::steady_clock::now() +
+				std::chrono::microseconds(std::max(0LL, max_wait_us_ - (current_timestamp() - pending_.front()->enqueue_us)));
+		pending_cv_.wait_until(lock, deadline, [this, batch] { return stop_ || (int)pending_.size() >= batch; });
+
+		running.clear();
+		while (!pending_.empty() && (int)running.size() < batch) {
+			running.push_back(pending_.front());
+			pending_.pop_front();
+		}
+		lock.unlock();
+
+		if (running.empty()) {
+			continue;
+		}
+
+		inputs.clear();
+		outputs.clear();
+		for (auto *req : running) {
+			inputs.push_back(req->input);
+			outputs.push_back(req->outputs);
+		}
+		int ret = backend_->run(inputs.data(), running.size(), outputs.data());
+		batches_++;
+		samples_ += running.size();
+
+		lock.lock();
+		for (auto *req : running) {
+			req->ret = ret;
+			req->done = true;
+		}
+		lock.unlock();
+		done_cv_.notify_all();
+	}
+}
+
+InferenceBroker::Stats InferenceBroker::get_stats() const
+{
+	Stats stats;
+	stats.batches = batches_.load();
+	stats.samples = samples_.load();
+	stats.avg_batch = stats.batches > 0 ? (double)stats.samples / stats.batches : 0.0;
+	return stats;
+}
@@ -0,0 +1,153 @@
+#ifndef __INFERENCE_BROKER_H__
+#define __INFERENCE_BROKER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rknn_api.h"
+#include "rknn_outputs.h"
+
+// Executes up to batch_size() model inputs in one call.
+class InferenceBackend {
+    public:
+	virtual ~InferenceBackend() {}
+
+	virtual int batch_size() const = 0;
+	// Bytes of one sample's input
+	virtual size_t input_size() const = 0;
+	virtual int num_outputs() const = 0;
+	// Per-output attributes; dims[0] is the batch dimension
+	virtual const rknn_tensor_attr *output_attrs() const = 0;
+
+	// Run count <= batch_size() samples. outputs[s][o] receives output o of sample s.
+	virtual int run(const void *const *inputs, int count, std::vector<std::vector<int8_t> > *const *outputs) = 0;
+};
+
+// Batch-N RKNN model; the batch size is the model's first input dimension.
+class RknnBatchBackend : public InferenceBackend {
+    public:
+	RknnBatchBackend();
+	~RknnBatchBackend();
+
+	int init(const char *model_path);
+
+	int batch_size() const override
+	{
+		return batch_;
+	}
+	size_t input_size() const override
+	{
+		return sample_input_size_;
+	}
+	int num_outputs() const override
+	{
+		return (int)output_attrs_.size();
+	}
+	const rknn_tensor_attr *output_attrs() const override
+	{
+		return output_attrs_.data();
+	}
+
+	int run(const void *const *inputs, int count, std::vector<std::vector<int8_t> > *const *outputs) override;
+
+    private:
+	rknn_context ctx_ = 0;
+	bool initialized_ = false;
+	int batch_ = 1;
+	size_t sample_input_size_ = 0;
+	std::vector<uint8_t> input_;
+	std::vector<rknn_tensor_attr> output_attrs_;
+	std::vector<size_t> sample_output_size_;
+	RknnOutputWorkspace outputs_; // whole-batch outputs, scattered to the samples after each run
+};
+
+// NPU-free stand-in: emits outputs at the zero point (no detections) after a
+// fixed per-call plus per-sample delay, so batching can be exercised anywhere.
+class MockInferenceBackend : public InferenceBackend {
+    public:
+	MockInferenceBackend(int batch, size_t input_size, const rknn_tensor_attr *output_attrs, int num_outputs, int call_us = 2000,
+			     int sample_us = 500);
+
+	int batch_size() const override
+	{
+		return batch_;
+	}
+	size_t input_size() const override
+	{
+		return input_size_;
+	}
+	int num_outputs() const override
+	{
+		return (int)output_attrs_.size();
+	}
+	const rknn_tensor_attr *output_attrs() const override
+	{
+		return output_attrs_.data();
+	}
+
+	int run(const void *const *inputs, int count, std::vector<std::vector<int8_t> > *const *outputs) override;
+
+    private:
+	int batch_;
+	size_t input_size_;
+	int call_us_;
+	int sample_us_;
+	std::vector<rknn_tensor_attr> output_attrs_;
+};
+
+// Collects single-sample requests from many channels and runs them as
+// batches on one backend. A batch is dispatched as soon as it is full or
+// the oldest request has waited max_wait_us, whichever comes first.
+class InferenceBroker {
+    public:
+	InferenceBroker(std::unique_ptr<InferenceBackend> backend, int max_wait_us);
+	~InferenceBroker();
+
+	// Blocks until the sample has run. outputs is resized to the backend's outputs.
+	int infer(const void *input, std::vector<std::vector<int8_t> > &outputs);
+
+	const InferenceBackend &backend() const
+	{
+		return *backend_;
+	}
+
+	struct Stats {
+		long long batches;
+		long long samples;
+		double avg_batch;
+	};
+	Stats get_stats() const;
+
+    private:
+	struct Request {
+		const void *input;
+		std::vector<std::vector<int8_t> > *outputs;
+		long long enqueue_us;
+		bool done;
+		int ret;
+	};
+
+	std::unique_ptr<InferenceBackend> backend_;
+	int max_wait_us_;
+
+	std::mutex mutex_;
+	std::condition_variable pending_cv_;
+	std::condition_variable done_cv_;
+	std::deque<Request *> pending_;
+	bool stop_ = false;
+	std::thread worker_;
+
+	std::atomic<long long> batches_{ 0 };
+	std::atomic<long long> samples_{ 0 };
+
+	void worker_loop();
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "latest_frame.h"
+
+LatestFrameSlot::LatestFrameSlot()
+{
+	frame_ = av_frame_alloc();
+}
+
+LatestFrameSlot::~LatestFrameSlot()
+{
+	av_frame_free(&frame_);
+}
+
+void LatestFrameSlot::put(AVFrame *frame, long long received_us)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (closed_) {
+			av_frame_unref(frame);
+			return;
+		}
+		if (full_) {
+			// The consumer never got to it; a newer frame makes it worthless
+			av_frame_unref(frame_);
+			stats_.superseded++;
+		}
+		av_frame_move_ref(frame_, frame);
+		received_us_ = received_us;
+		full_ = true;
+		stats_.published++;
+	}
+	cv_.notify_one();
+}
+
+bool LatestFrameSlot::take(AVFrame *out, long long *received_us)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	cv_.wait(lock, [this] { return full_ || closed_; });
+	if (closed_) {
+		return false;
+	}
+	av_frame_unref(out);
+	av_frame_move_ref(out, frame_);
+	*received_us = received_us_;
+	full_ = false;
+	stats_.consumed++;
+	return true;
+}
+
+void LatestFrameSlot::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		closed_ = true;
+		if (full_) {
+			av_frame_unref(frame_);
+			full_ = false;
+			stats_.superseded++;
+		}
+	}
+	cv_.notify_all();
+}
+
+void LatestFrameSlot::reset()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	closed_ = false;
+	stats_ = { 0, 0, 0 };
+}
+
+LatestFrameSlot::Stats LatestFrameSlot::get_stats()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
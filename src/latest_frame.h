@@ -0,0 +1,55 @@
+#ifndef __LATEST_FRAME_H__
+#define __LATEST_FRAME_H__
+
+#include <condition_variable>
+#include <mutex>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavutil/frame.h>
+#ifdef __cplusplus
+}
+#endif
+
+// Single-slot hand-off between a decode thread and a processing thread.
+//
+// The decoder publishes every frame it produces; a frame that is still
+// waiting when the next one arrives is released on the spot. The consumer
+// therefore always gets the newest frame and at most one frame is queued,
+// which bounds latency to one frame plus the processing time.
+class LatestFrameSlot {
+    public:
+	LatestFrameSlot();
+	~LatestFrameSlot();
+
+	// Take ownership of frame's references; frame is left blank.
+	// received_us is when the decoder handed the frame over.
+	void put(AVFrame *frame, long long received_us);
+
+	// Block until a frame is available and move it into out, with its receive time.
+	// Returns false once the slot is closed.
+	bool take(AVFrame *out, long long *received_us);
+
+	// Wake the consumer and drop any pending frame. reset() reopens the slot.
+	void close();
+	void reset();
+
+	struct Stats {
+		long long published;
+		long long consumed;
+		long long superseded; // released without being processed
+	};
+	Stats get_stats();
+
+    private:
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	AVFrame *frame_;
+	long long received_us_ = 0;
+	bool full_ = false;
+	bool closed_ = false;
+	Stats stats_ = { 0, 0, 0 };
+};
+
+#endif
@@ -46,8 +46,8 @@ int main(int argc, char *argv[])
 	signal(SIGPIPE, SIG_IGN);
 
 	if (argc < 2) {
-		printf("Usage: %s <stream_url>\n", argv[0]);
-		printf("Example: %s rtsp://example.com/stream\n", argv[0]);
+		printf("Usage: %s <stream_url> [inference_interval]\n", argv[0]);
+		printf("Example: %s rtsp://example.com/stream 3\n", argv[0]);
 		return -1;
 	}
 
@@ -55,6 +55,10 @@ int main(int argc, char *argv[])
 	FFmpegStreamChannel *channel = new FFmpegStreamChannel();
 	g_channel = channel;  // Set global pointer for signal handling
 
+	if (argc >= 3) {
+		channel->set_inference_interval(atoi(argv[2]));
+	}
+
 	printf("DEBUG: Channel created, starting continuous decode with: %s\n", argv[1]);
 	printf("INFO: MJPEG stream will be available at http://localhost:8090/mjpeg\n");
 	printf("INFO: Web interface available at http://localhost:8090/\n");
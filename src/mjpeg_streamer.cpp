@@ -419,11 +419,13 @@ void SimpleHTTPServer::send_multi_stream_page(int client_fd) {
 MJPEGStreamer::MJPEGStreamer()
     : server_(nullptr), encoder_(nullptr), port_(8090), width_(1280), height_(720),
       running_(false), should_stop_(false), clients_connected_(0), frames_encoded_(0),
-      frames_dropped_(0), avg_encode_time_ms_(0.0), fps_(0.0) {
+      frames_dropped_(0), frames_unchanged_(0), avg_encode_time_ms_(0.0), fps_(0.0) {
+    sem_init(&frame_ready_, 0, 0);
 }
 
 MJPEGStreamer::~MJPEGStreamer() {
     stop();
+    sem_destroy(&frame_ready_);
 }
 
 int MJPEGStreamer::init(int port, int width, int height) {
@@ -444,6 +446,11 @@ int MJPEGStreamer::init(int port, int width, int height) {
         return get_current_jpeg(jpeg_data);
     });
 
+    // Mailbox slots are sized up front so frames are copied into existing buffers
+    for (int i = 0; i < TripleBuffer<FrameData>::SLOT_COUNT; i++) {
+        frames_.slot(i).frame.create(height_, width_, CV_8UC3);
+    }
+
     printf("MJPEG Streamer initialized: %dx%d, port=%d\n", width_, height_, port_);
     return 0;
 }
@@ -487,7 +494,7 @@ void MJPEGStreamer::stop() {
     }
 
     // Wake up encoder thread
-    queue_cv_.notify_all();
+    sem_post(&frame_ready_);
     jpeg_cv_.notify_all();
 
     // Wait for encoder thread to finish
@@ -495,12 +502,9 @@ void MJPEGStreamer::stop() {
         encoder_thread_.join();
     }
 
-    // Clear queues
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        while (!frame_queue_.empty()) {
-            frame_queue_.pop();
-        }
+    // A restart must not encode a frame from before the stop
+    frames_.discard();
+    while (sem_trywait(&frame_ready_) == 0) {
     }
 
     {
@@ -517,30 +521,44 @@ void MJPEGStreamer::push_frame(const cv::Mat& frame, const detect_result_group_t
         return;
     }
 
-    std::unique_lock<std::mutex> lock(queue_mutex_);
+    // The only copy: into the slot's own buffer, which copyTo reuses when the size matches
+    FrameData& slot = frames_.back();
+    frame.copyTo(slot.frame);
+    slot.detection_results = detection_results;
+    slot.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 
-    // Drop frames if queue is full
-    if (frame_queue_.size() >= MAX_QUEUE_SIZE) {
-        frame_queue_.pop();
+    if (frames_.publish()) {
+        // The encoder never saw the previous frame; its slot is ours to refill next time.
+        // Its wake-up is still pending, so no new one is needed.
         frames_dropped_++;
+        return;
     }
-
-    frame_queue_.emplace(frame, detection_results, std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now().time_since_epoch()).count());
-
-    lock.unlock();
-    queue_cv_.notify_one();
+    sem_post(&frame_ready_);
 }
 
-void MJPEGStreamer::push_frame_raw(const uint8_t* bgr_data, int width, int height, const detect_result_group_t& detection_results) {
+void MJPEGStreamer::push_frame_raw(const uint8_t* bgr_data, int width, int height, int pitch, const detect_result_group_t& detection_results,
+                                   bool content_changed) {
     if (width != width_ || height != height_) {
         printf("MJPEG Streamer: Frame size mismatch: expected %dx%d, got %dx%d\n",
                width_, height_, width, height);
         return;
     }
 
-    // Validate and potentially correct color format
-    cv::Mat frame = validate_and_correct_color_format(bgr_data, width, height);
+    // A static scene with nothing drawn on it looks exactly like the last JPEG.
+    // Still refresh occasionally so a missed change does not stick forever.
+    auto now = std::chrono::steady_clock::now();
+    bool has_detections = detection_results.count > 0;
+    if (!content_changed && !has_detections && !last_had_detections_ &&
+        now - last_push_time_ < std::chrono::milliseconds(MJPEG_STATIC_REFRESH_MS)) {
+        frames_unchanged_++;
+        return;
+    }
+    last_push_time_ = now;
+    last_had_detections_ = has_detections;
+
+    // The converters always write BGR for the stream's own matrix and range
+    cv::Mat frame(height, width, CV_8UC3, (void*)bgr_data, pitch);
     push_frame(frame, detection_results);
 }
 
@@ -552,26 +570,24 @@ void MJPEGStreamer::encoder_worker() {
     double total_encode_time = 0.0;
 
     while (!should_stop_) {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
-
         // Wait for frames
-        queue_cv_.wait(lock, [this] { return !frame_queue_.empty() || should_stop_; });
+        if (sem_wait(&frame_ready_) != 0 && errno != EINTR) {
+            break;
+        }
 
         if (should_stop_) {
             break;
         }
 
-        if (frame_queue_.empty()) {
+        // Get the latest frame; the slot stays ours until the next take()
+        if (!frames_.take()) {
             continue;
         }
+        FrameData& frame_data = frames_.front();
 
-        // Get the latest frame
-        FrameData frame_data = frame_queue_.front();
-        frame_queue_.pop();
-        lock.unlock();
-
-        // Draw detection results on frame
-        cv::Mat annotated_frame = draw_detection_results(frame_data.frame, frame_data.detection_results);
+        // Draw detection results straight onto the slot
+        draw_detection_results(frame_data.frame, frame_data.detection_results);
+        const cv::Mat& annotated_frame = frame_data.frame;
 
         // Encode frame
         auto encode_start = std::chrono::high_resolution_clock::now();
@@ -613,9 +629,7 @@ void MJPEGStreamer::encoder_worker() {
     printf("MJPEG Streamer: Encoder worker stopped\n");
 }
 
-cv::Mat MJPEGStreamer::draw_detection_results(const cv::Mat& frame, const detect_result_group_t& results) {
-    cv::Mat annotated_frame = frame.clone();
-
+void MJPEGStreamer::draw_detection_results(cv::Mat& annotated_frame, const detect_result_group_t& results) {
     // Draw bounding boxes and labels
     for (int i = 0; i < results.count; i++) {
         const detect_result_t* result = &results.results[i];
@@ -627,7 +641,11 @@ cv::Mat MJPEGStreamer::draw_detection_results(const cv::Mat& frame, const detect
 
         // Prepare label text
         char label_text[256];
-        snprintf(label_text, sizeof(label_text), "%s %.1f%%", result->name, result->prop * 100);
+        if (result->track_id > 0) {
+            snprintf(label_text, sizeof(label_text), "#%d %s %.1f%%", result->track_id, result->name, result->prop * 100);
+        } else {
+            snprintf(label_text, sizeof(label_text), "%s %.1f%%", result->name, result->prop * 100);
+        }
 
         // Calculate text size and background
         int baseline = 0;
@@ -656,8 +674,6 @@ cv::Mat MJPEGStreamer::draw_detection_results(const cv::Mat& frame, const detect
 
     cv::putText(annotated_frame, ss.str(), cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(255, 255, 255), 2);
     cv::putText(annotated_frame, ss.str(), cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(0, 0, 0), 1);
-
-    return annotated_frame;
 }
 
 bool MJPEGStreamer::get_current_jpeg(std::vector<uint8_t>& jpeg_data) {
@@ -670,61 +686,6 @@ bool MJPEGStreamer::get_current_jpeg(std::vector<uint8_t>& jpeg_data) {
     return true;
 }
 
-cv::Mat MJPEGStreamer::validate_and_correct_color_format(const uint8_t* bgr_data, int width, int height) {
-    // Create initial frame assuming BGR format
-    cv::Mat frame(height, width, CV_8UC3, (void*)bgr_data);
-
-    // Sample center pixel for color validation
-    int center_x = width / 2;
-    int center_y = height / 2;
-    cv::Vec3b center_pixel = frame.at<cv::Vec3b>(center_y, center_x);
-
-    // Sample corner pixels for additional validation
-    cv::Vec3b corner_tl = frame.at<cv::Vec3b>(0, 0);
-    cv::Vec3b corner_br = frame.at<cv::Vec3b>(height-1, width-1);
-
-    printf("DEBUG: MJPEG input validation - Center pixel BGR: B=%d, G=%d, R=%d\n",
-           center_pixel[0], center_pixel[1], center_pixel[2]);
-
-    // Detect potential RGB data in BGR buffer
-    // Look for patterns where blue channel has values that seem more like red
-    bool likely_rgb_swapped = false;
-
-    // Check if blue channel values are consistently higher than red (suggesting RGB->BGR swap)
-    int blue_vs_red_diff = center_pixel[0] - center_pixel[2];
-    int corner_blue_vs_red_diff = corner_tl[0] - corner_tl[2];
-
-    if (blue_vs_red_diff > 30 && corner_blue_vs_red_diff > 30) {
-        // Blue significantly higher than red in multiple samples suggests RGB data
-        likely_rgb_swapped = true;
-        printf("WARNING: MJPEG detected likely RGB data in BGR buffer (blue > red by %d)\n", blue_vs_red_diff);
-    }
-
-    // Check for unrealistic color values that might indicate format issues
-    bool has_extreme_values = (center_pixel[0] > 250 && center_pixel[2] < 50) ||
-                             (center_pixel[2] > 250 && center_pixel[0] < 50);
-
-    if (has_extreme_values) {
-        printf("WARNING: MJPEG detected extreme color values - possible format mismatch\n");
-        likely_rgb_swapped = true;
-    }
-
-    if (likely_rgb_swapped) {
-        printf("INFO: MJPEG applying RGB->BGR color correction\n");
-        cv::Mat corrected_frame;
-        cv::cvtColor(frame, corrected_frame, cv::COLOR_RGB2BGR);
-
-        // Verify correction
-        cv::Vec3b corrected_center = corrected_frame.at<cv::Vec3b>(center_y, center_x);
-        printf("DEBUG: MJPEG after correction - Center pixel BGR: B=%d, G=%d, R=%d\n",
-               corrected_center[0], corrected_center[1], corrected_center[2]);
-
-        return corrected_frame;
-    }
-
-    return frame;
-}
-
 // Debug frame saving function removed for production use
 
 MJPEGStreamer::StreamStats MJPEGStreamer::get_stats() const {
@@ -732,6 +693,7 @@ MJPEGStreamer::StreamStats MJPEGStreamer::get_stats() const {
     stats.clients_connected = clients_connected_.load();
     stats.frames_encoded = frames_encoded_.load();
     stats.frames_dropped = frames_dropped_.load();
+    stats.frames_unchanged = frames_unchanged_.load();
     stats.avg_encode_time_ms = avg_encode_time_ms_.load();
     stats.fps = fps_.load();
     return stats;
@@ -4,8 +4,8 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
 #include <atomic>
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <string>
@@ -14,9 +14,11 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <functional>
+#include <semaphore.h>
 #include "config.h"
 #include "mpp_encoder.h"
 #include "yolov5s_postprocess.h"
+#include "triple_buffer.h"
 
 // Simple HTTP server implementation
 class SimpleHTTPServer {
@@ -47,18 +49,16 @@ private:
     void send_multi_stream_page(int client_fd);
 };
 
-// Frame data structure for thread-safe communication
+// One frame handed to the encoder. The frame buffer is allocated once per
+// mailbox slot and overwritten in place.
 struct FrameData {
     cv::Mat frame;
     detect_result_group_t detection_results;
     long long timestamp;
 
     FrameData() : timestamp(0) {
-        memset(&detection_results, 0, sizeof(detect_result_group_t));
+        detection_results.results.reserve(OBJ_NUMB_MAX_SIZE);
     }
-
-    FrameData(const cv::Mat& f, const detect_result_group_t& results, long long ts)
-        : frame(f.clone()), detection_results(results), timestamp(ts) {}
 };
 
 class MJPEGStreamer {
@@ -77,11 +77,15 @@ public:
     // Stop the HTTP server
     void stop();
 
-    // Add a new frame with detection results to the streaming queue
+    // Hand a frame with detection results to the encoder. Copies the frame
+    // once and never blocks; a frame the encoder has not started on yet is
+    // replaced and counted as dropped.
     void push_frame(const cv::Mat& frame, const detect_result_group_t& detection_results);
 
-    // Push frame from raw BGR data
-    void push_frame_raw(const uint8_t* bgr_data, int width, int height, const detect_result_group_t& detection_results);
+    // Push frame from raw BGR data with rows pitch bytes apart. Unchanged frames
+    // without detections are not re-encoded; the server keeps resending the last JPEG instead.
+    void push_frame_raw(const uint8_t* bgr_data, int width, int height, int pitch, const detect_result_group_t& detection_results,
+                        bool content_changed = true);
 
     // Check if the streamer is running
     bool is_running() const { return running_; }
@@ -91,6 +95,7 @@ public:
         int clients_connected;
         int frames_encoded;
         int frames_dropped;
+        int frames_unchanged;
         double avg_encode_time_ms;
         double fps;
     };
@@ -108,11 +113,10 @@ private:
     std::atomic<bool> running_;
     std::atomic<bool> should_stop_;
 
-    // Frame processing
+    // Frame processing: push_frame() is the producer, encoder_worker() the consumer
     std::thread encoder_thread_;
-    std::queue<FrameData> frame_queue_;
-    std::mutex queue_mutex_;
-    std::condition_variable queue_cv_;
+    TripleBuffer<FrameData> frames_;
+    sem_t frame_ready_; // posted when a publish may have found the encoder idle
 
     // JPEG data management
     std::vector<uint8_t> current_jpeg_;
@@ -123,6 +127,11 @@ private:
     std::atomic<int> clients_connected_;
     std::atomic<int> frames_encoded_;
     std::atomic<int> frames_dropped_;
+    std::atomic<int> frames_unchanged_;
+
+    // Static-scene skipping (producer thread only)
+    std::chrono::steady_clock::time_point last_push_time_;
+    bool last_had_detections_ = true;
     std::atomic<double> avg_encode_time_ms_;
     std::atomic<double> fps_;
 
@@ -130,8 +139,7 @@ private:
     void encoder_worker();
 
     // Frame processing
-    cv::Mat draw_detection_results(const cv::Mat& frame, const detect_result_group_t& results);
-    cv::Mat validate_and_correct_color_format(const uint8_t* bgr_data, int width, int height);
+    void draw_detection_results(cv::Mat& frame, const detect_result_group_t& results);
 
     // MJPEG provider for HTTP server
     bool get_current_jpeg(std::vector<uint8_t>& jpeg_data);
@@ -139,8 +147,6 @@ private:
     // HTTP request handlers
     void handle_index_request(std::string& response);
     void handle_stats_request(std::string& response);
-
-    static const int MAX_QUEUE_SIZE = 5;
 };
 
 #endif // __MJPEG_STREAMER_H__
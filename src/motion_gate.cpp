@@ -0,0 +1,117 @@
+#include "motion_gate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavutil/motion_vector.h>
+#ifdef __cplusplus
+}
+#endif
+
+static const int THUMB_CELLS = MOTION_THUMB_W * MOTION_THUMB_H;
+// Samples per thumbnail cell along each axis; averaging suppresses sensor noise
+static const int CELL_SAMPLES = 4;
+// Background adaptation rate per evaluated frame
+static const float BACKGROUND_ALPHA = 0.05f;
+
+MotionGate::MotionGate() : thumb_(THUMB_CELLS, 0), background_(THUMB_CELLS, 0.f), last_shown_(THUMB_CELLS, 0)
+{
+}
+
+void MotionGate::build_thumbnail(const uint8_t *bgr, int width, int height, int pitch)
+{
+	for (int ty = 0; ty < MOTION_THUMB_H; ty++) {
+		int y0 = ty * height / MOTION_THUMB_H;
+		int cell_h = std::max(1, height / MOTION_THUMB_H);
+		for (int tx = 0; tx < MOTION_THUMB_W; tx++) {
+			int x0 = tx * width / MOTION_THUMB_W;
+			int cell_w = std::max(1, width / MOTION_THUMB_W);
+
+			int sum = 0;
+			for (int sy = 0; sy < CELL_SAMPLES; sy++) {
+				const uint8_t *row = bgr + (size_t)(y0 + sy * cell_h / CELL_SAMPLES) * pitch;
+				for (int sx = 0; sx < CELL_SAMPLES; sx++) {
+					const uint8_t *px = row + (x0 + sx * cell_w / CELL_SAMPLES) * 3;
+					// BT.601 luma in fixed point
+					sum += (px[0] * 29 + px[1] * 150 + px[2] * 77) >> 8;
+				}
+			}
+			thumb_[ty * MOTION_THUMB_W + tx] = sum / (CELL_SAMPLES * CELL_SAMPLES);
+		}
+	}
+}
+
+bool MotionGate::evaluate(const uint8_t *bgr, int width, int height, int pitch, long long now_us)
+{
+	if (!bgr || width < MOTION_THUMB_W || height < MOTION_THUMB_H) {
+		return true;
+	}
+
+	build_thumbnail(bgr, width, height, pitch);
+
+	if (!has_background_) {
+		for (int i = 0; i < THUMB_CELLS; i++) {
+			background_[i] = thumb_[i];
+		}
+		last_shown_ = thumb_;
+		has_background_ = true;
+		content_changed_ = true;
+		return decide(1.f, now_us);
+	}
+
+	int changed = 0;
+	int shown_changed = 0;
+	for (int i = 0; i < THUMB_CELLS; i++) {
+		if (abs(thumb_[i] - (int)background_[i]) > MOTION_PIXEL_THRESH) {
+			changed++;
+		}
+		if (abs(thumb_[i] - last_shown_[i]) > MOTION_PIXEL_THRESH) {
+			shown_changed++;
+		}
+		background_[i] += BACKGROUND_ALPHA * (thumb_[i] - background_[i]);
+	}
+
+	content_changed_ = shown_changed > 0;
+	if (content_changed_) {
+		last_shown_ = thumb_;
+	}
+
+	return decide((float)changed / THUMB_CELLS, now_us);
+}
+
+bool MotionGate::evaluate_motion_vectors(const AVMotionVector *mvs, int count, int width, int height, long long now_us)
+{
+	if (width <= 0 || height <= 0) {
+		return true;
+	}
+
+	// Area covered by blocks that actually moved, relative to the frame
+	long long moving_area = 0;
+	for (int i = 0; i < count; i++) {
+		if (mvs[i].motion_x != 0 || mvs[i].motion_y != 0) {
+			moving_area += mvs[i].w * mvs[i].h;
+		}
+	}
+	float score = std::min(1.f, (float)moving_area / ((float)width * height));
+
+	content_changed_ = moving_area > 0;
+	return decide(score, now_us);
+}
+
+bool MotionGate::decide(float score, long long now_us)
+{
+	last_score_ = score;
+	if (!enabled_) {
+		return true;
+	}
+
+	if (score > threshold_ || now_us - last_trigger_us_ >= heartbeat_us_) {
+		last_trigger_us_ = now_us;
+		return true;
+	}
+	return false;
+}
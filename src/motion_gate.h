@@ -0,0 +1,79 @@
+#ifndef __MOTION_GATE_H__
+#define __MOTION_GATE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "config.h"
+
+struct AVMotionVector;
+
+// Cheap scene-change detector that decides whether a frame is worth inferring.
+//
+// Each frame is reduced to a MOTION_THUMB_W x MOTION_THUMB_H luma thumbnail
+// sampled from the display buffer and compared against an exponentially
+// updated background. The change score is the fraction of thumbnail cells
+// that differ from the background by more than MOTION_PIXEL_THRESH. When
+// the decoder exports motion vectors, their coverage is used instead.
+//
+// A heartbeat forces inference every heartbeat interval so a stationary
+// object that entered between two gated frames is still picked up.
+class MotionGate {
+    public:
+	MotionGate();
+
+	// Score a BGR888 frame whose rows are pitch bytes apart. Returns true when inference should run.
+	bool evaluate(const uint8_t *bgr, int width, int height, int pitch, long long now_us);
+
+	// Score decoder motion vectors (AV_FRAME_DATA_MOTION_VECTORS). Returns true when inference should run.
+	bool evaluate_motion_vectors(const AVMotionVector *mvs, int count, int width, int height, long long now_us);
+
+	// True when the last evaluated frame differs from the last one reported as changed.
+	// Lets the MJPEG side skip re-encoding static frames.
+	bool content_changed() const
+	{
+		return content_changed_;
+	}
+
+	float last_score() const
+	{
+		return last_score_;
+	}
+
+	void set_threshold(float fraction)
+	{
+		threshold_ = fraction;
+	}
+	void set_heartbeat_ms(int ms)
+	{
+		heartbeat_us_ = (long long)ms * 1000;
+	}
+	void set_enabled(bool enabled)
+	{
+		enabled_ = enabled;
+	}
+	bool enabled() const
+	{
+		return enabled_;
+	}
+
+    private:
+	bool enabled_ = MOTION_GATE_DEFAULT;
+	float threshold_ = MOTION_THRESHOLD_DEFAULT;
+	long long heartbeat_us_ = (long long)MOTION_HEARTBEAT_MS * 1000;
+
+	std::vector<uint8_t> thumb_;
+	std::vector<float> background_;
+	std::vector<uint8_t> last_shown_; // thumbnail of the last frame reported as changed
+	bool has_background_ = false;
+
+	long long last_trigger_us_ = 0;
+	float last_score_ = 0.f;
+	bool content_changed_ = true;
+
+	void build_thumbnail(const uint8_t *bgr, int width, int height, int pitch);
+	bool decide(float score, long long now_us);
+};
+
+#endif
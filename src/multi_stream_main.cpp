@@ -14,6 +14,8 @@
 #include <memory>
 #include <atomic>
 #include <chrono>
+#include <mutex>
+#include <future>
 
 #include "ffmpeg.h"
 
@@ -54,21 +56,102 @@ struct StreamConfig {
     std::string video_path;
     int mjpeg_port;
     int stream_id;
+    int inference_interval = INFERENCE_INTERVAL_DEFAULT;  // max frames per detector run, adapted by the tracker
+    bool motion_gate = MOTION_GATE_DEFAULT;               // skip inference while the scene is static
+    float motion_threshold = MOTION_THRESHOLD_DEFAULT;    // changed-area fraction that counts as motion
+    float roi[4] = {0.f, 0.f, 1.f, 1.f};                  // model ROI as x, y, w, h fractions of the frame
+    int tile_cols = 1;                                    // tiled inference layout over the ROI
+    int tile_rows = 1;
+    bool tile_full_frame_pass = false;                    // extra whole-ROI pass for large objects
+    ModelConfig model;                                    // lighter models trade accuracy for throughput
+    float npu_weight = NPU_SCHED_DEFAULT_WEIGHT;          // share of spare NPU time
+    float npu_target_fps = NPU_SCHED_DEFAULT_FPS;         // guaranteed inference rate before fair sharing
+    int npu_deadline_ms = NPU_SCHED_DEFAULT_DEADLINE_MS;  // older frames are dropped instead of inferred
+    bool live_mode = LIVE_MODE_DEFAULT;                   // RTSP: process only the newest decoded frame
+    DecodePolicy decode_policy = DECODE_POLICY_AUTO;      // skip decode work the inference interval makes useless
+    bool loop_files = FILE_LOOP_DEFAULT;                  // files restart in place at EOF
+    std::string open_profile = OPEN_PROFILE_DEFAULT;      // probesize/analyzeduration used when (re)connecting
 };
 
+// All channels share the NPU through one scheduler
+static std::shared_ptr<NpuScheduler> g_npu_scheduler = std::make_shared<NpuScheduler>();
+
+// One broker shared by all channels when a batch model is configured
+static std::mutex g_broker_mutex;
+static std::shared_ptr<InferenceBroker> g_broker;
+static bool g_broker_tried = false;
+
+static std::shared_ptr<InferenceBroker> shared_inference_broker(FFmpegStreamChannel *channel)
+{
+    std::lock_guard<std::mutex> lock(g_broker_mutex);
+    if (g_broker_tried) {
+        return g_broker;
+    }
+    g_broker_tried = true;
+
+    // Unbatched channels each run their own context, so every NPU core can be busy at once
+    g_npu_scheduler->set_concurrency(NPU_CORE_COUNT);
+
+    std::string batch_model = INFERENCE_BATCH_MODEL_PATH;
+    if (batch_model.empty()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<InferenceBackend> backend;
+    if (batch_model == "mock") {
+        // Same tensor shapes as the channel's model, no NPU involved
+        size_t input_size = (size_t)channel->rknn_width_ * channel->rknn_height_ * channel->rknn_input_channel;
+        backend.reset(new MockInferenceBackend(INFERENCE_BATCH_MOCK_SIZE, input_size, channel->output_attrs, channel->io_num.n_output));
+    } else {
+        std::unique_ptr<RknnBatchBackend> rknn_backend(new RknnBatchBackend());
+        if (rknn_backend->init(batch_model.c_str()) != 0) {
+            printf("WARNING: Failed to load batch model %s, channels run unbatched\n", batch_model.c_str());
+            return nullptr;
+        }
+        backend = std::move(rknn_backend);
+    }
+
+    printf("INFO: Batched inference enabled: batch=%d, max wait %dus\n", backend->batch_size(), INFERENCE_BATCH_MAX_WAIT_US);
+    // Let the scheduler admit a whole batch at a time, otherwise batches never fill
+    g_npu_scheduler->set_concurrency(backend->batch_size());
+    g_broker = std::make_shared<InferenceBroker>(std::move(backend), INFERENCE_BATCH_MAX_WAIT_US);
+    return g_broker;
+}
+
 // Worker function for each video stream
-void stream_worker(const StreamConfig& config) {
+// `opening` is the stream's input, opened by main() in parallel with all other streams
+void stream_worker(const StreamConfig& config, std::future<AVFormatContext*> opening) {
     printf("INFO: Starting stream %d - %s on port %d\n",
            config.stream_id, config.video_path.c_str(), config.mjpeg_port);
 
-    auto channel = std::make_unique<FFmpegStreamChannel>();
+    long long init_start_us = current_timestamp();
+    auto channel = std::make_unique<FFmpegStreamChannel>(config.model);
 
     // Configure the channel for this specific stream
     if (!channel->init_for_multi_stream(config.mjpeg_port)) {
         printf("ERROR: Failed to initialize channel for stream %d\n", config.stream_id);
+        channel->adopt_input(opening.get());  // closed with the channel
         return;
     }
 
+    printf("INFO: Stream %d initialized in %.1fms\n", config.stream_id, (current_timestamp() - init_start_us) / 1000.0);
+
+    channel->set_inference_interval(config.inference_interval);
+    channel->set_motion_gate(config.motion_gate, config.motion_threshold);
+    channel->set_roi(config.roi[0], config.roi[1], config.roi[2], config.roi[3]);
+    channel->set_live_mode(config.live_mode);
+    channel->set_decode_policy(config.decode_policy);
+    channel->set_file_looping(config.loop_files);
+    channel->set_tiling(config.tile_cols, config.tile_rows, TILE_OVERLAP_DEFAULT, config.tile_full_frame_pass);
+    channel->set_inference_broker(shared_inference_broker(channel.get()));
+    channel->set_npu_scheduler(g_npu_scheduler, "stream" + std::to_string(config.stream_id), config.npu_weight, config.npu_target_fps,
+                               config.npu_deadline_ms);
+    channel->set_best_shot_source("stream" + std::to_string(config.stream_id));
+
+    channel->set_open_profile(config.open_profile);
+    // A failed open is retried by decode_continuous with the same profile
+    channel->adopt_input(opening.get());
+
     // Start continuous decoding
     bool result = channel->decode_continuous(config.video_path.c_str());
 
@@ -114,14 +197,22 @@ int main(int argc, char *argv[])
     printf("INFO: Individual streams: http://YOUR_SERVER_IP:809X/mjpeg (X=0-7)\n");
     printf("INFO: Press Ctrl+C to stop all streams gracefully\n\n");
 
+    // Open every input at once; probing overlaps with channel start-up
+    av_register_all();
+    avformat_network_init();
+    std::vector<std::future<AVFormatContext*>> openings;
+    for (const auto& config : stream_configs) {
+        openings.push_back(std::async(std::launch::async, [config] {
+            return open_stream_input(config.video_path, find_open_profile(config.open_profile, config.video_path.c_str()));
+        }));
+    }
+
     // Create and start worker threads for each stream
     std::vector<std::thread> worker_threads;
 
-    for (const auto& config : stream_configs) {
-        worker_threads.emplace_back(stream_worker, config);
-
-        // Small delay between starting streams to avoid resource conflicts
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for (size_t i = 0; i < stream_configs.size(); i++) {
+        // All channels initialize at once; the model is loaded once and shared (HardwareRuntime)
+        worker_threads.emplace_back(stream_worker, stream_configs[i], std::move(openings[i]));
     }
 
     // Wait for all threads to complete or shutdown signal
@@ -0,0 +1,166 @@
+#include "nms.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "config.h"
+
+// Boxes use the inclusive-pixel convention of the original post-processing: a box spans x2 - x1 + 1 pixels
+static inline float box_area(float x1, float y1, float x2, float y2)
+{
+	return (x2 - x1 + 1.f) * (y2 - y1 + 1.f);
+}
+
+void NmsEngine::reserve(size_t candidates)
+{
+	order_.reserve(candidates);
+	size_t kept = std::min(candidates, (size_t)NMS_TOPK);
+	kept_.reserve(kept);
+	x1_.reserve(kept);
+	y1_.reserve(kept);
+	x2_.reserve(kept);
+	y2_.reserve(kept);
+	area_.reserve(kept);
+}
+
+void NmsEngine::keep(int index, float x1, float y1, float x2, float y2, float area)
+{
+	kept_.push_back(index);
+	x1_.push_back(x1);
+	y1_.push_back(y1);
+	x2_.push_back(x2);
+	y2_.push_back(y2);
+	area_.push_back(area);
+}
+
+// IoU > threshold, written as inter > threshold * union to avoid the division
+bool NmsEngine::overlaps_slot(int slot, float x1, float y1, float x2, float y2, float area, float threshold) const
+{
+	float w = std::max(0.f, std::min(x2, x2_[slot]) - std::max(x1, x1_[slot]) + 1.f);
+	float h = std::max(0.f, std::min(y2, y2_[slot]) - std::max(y1, y1_[slot]) + 1.f);
+	float inter = w * h;
+	return inter > threshold * (area + area_[slot] - inter);
+}
+
+bool NmsEngine::overlaps_kept(float x1, float y1, float x2, float y2, float area, float threshold) const
+{
+	int n = (int)kept_.size();
+	int k = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	const float32x4_t bx1 = vdupq_n_f32(x1);
+	const float32x4_t by1 = vdupq_n_f32(y1);
+	const float32x4_t bx2 = vdupq_n_f32(x2);
+	const float32x4_t by2 = vdupq_n_f32(y2);
+	const float32x4_t barea = vdupq_n_f32(area);
+	const float32x4_t thr = vdupq_n_f32(threshold);
+	const float32x4_t one = vdupq_n_f32(1.f);
+	const float32x4_t zero = vdupq_n_f32(0.f);
+	for (; k + 4 <= n; k += 4) {
+		float32x4_t w = vaddq_f32(vsubq_f32(vminq_f32(bx2, vld1q_f32(&x2_[k])), vmaxq_f32(bx1, vld1q_f32(&x1_[k]))), one);
+		float32x4_t h = vaddq_f32(vsubq_f32(vminq_f32(by2, vld1q_f32(&y2_[k])), vmaxq_f32(by1, vld1q_f32(&y1_[k]))), one);
+		float32x4_t inter = vmulq_f32(vmaxq_f32(w, zero), vmaxq_f32(h, zero));
+		float32x4_t uni = vsubq_f32(vaddq_f32(barea, vld1q_f32(&area_[k])), inter);
+		if (vmaxvq_u32(vcgtq_f32(inter, vmulq_f32(thr, uni)))) {
+			return true;
+		}
+	}
+#endif
+	for (; k < n; k++) {
+		if (overlaps_slot(k, x1, y1, x2, y2, area, threshold)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+const std::vector<int> &NmsEngine::run(const float *boxes, const float *scores, const int *class_ids, int count, float iou_threshold)
+{
+	kept_.clear();
+	x1_.clear();
+	y1_.clear();
+	x2_.clear();
+	y2_.clear();
+	area_.clear();
+	if (count <= 0) {
+		return kept_;
+	}
+
+	// Top-K by score: a linear-time selection, then only the survivors are sorted
+	order_.resize(count);
+	for (int i = 0; i < count; i++) {
+		order_[i] = i;
+	}
+	auto by_score = [scores](int a, int b) { return scores[a] > scores[b] || (scores[a] == scores[b] && a < b); };
+	if (count > NMS_TOPK) {
+		std::nth_element(order_.begin(), order_.begin() + NMS_TOPK, order_.end(), by_score);
+		order_.resize(NMS_TOPK);
+	}
+	std::sort(order_.begin(), order_.end(), by_score);
+
+	// Class offset: each class gets a slice of the plane wider than every box, so classes never overlap
+	float min_c = boxes[order_[0] * 4], max_c = min_c;
+	for (int n : order_) {
+		const float *b = &boxes[n * 4];
+		min_c = std::min(min_c, std::min(b[0], b[1]));
+		max_c = std::max(max_c, std::max(b[0] + b[2], b[1] + b[3]));
+	}
+	const float class_offset = max_c - min_c + 2.f;
+
+	// Grid over the unshifted candidate extent; a kept box is listed in every cell it touches
+	int cells = NMS_GRID_CELLS;
+	bool use_grid = cells > 0 && (int)order_.size() >= NMS_GRID_MIN_CANDIDATES;
+	float cell_size = std::max(1.f, (max_c - min_c) / std::max(cells, 1) + 1.f);
+	if (use_grid) {
+		cells_.resize(cells * cells);
+		for (auto &cell : cells_) {
+			cell.clear();
+		}
+	}
+	auto cell_of = [&](float v) { return std::max(0, std::min(cells - 1, (int)((v - min_c) / cell_size))); };
+
+	for (int n : order_) {
+		const float *b = &boxes[n * 4];
+		float shift = class_ids[n] * class_offset;
+		float x1 = b[0] + shift;
+		float y1 = b[1] + shift;
+		float x2 = b[0] + b[2] + shift;
+		float y2 = b[1] + b[3] + shift;
+		float area = box_area(x1, y1, x2, y2);
+
+		if (!use_grid) {
+			if (!overlaps_kept(x1, y1, x2, y2, area, iou_threshold)) {
+				keep(n, x1, y1, x2, y2, area);
+			}
+			continue;
+		}
+
+		int cx0 = cell_of(b[0]), cx1 = cell_of(b[0] + b[2]);
+		int cy0 = cell_of(b[1]), cy1 = cell_of(b[1] + b[3]);
+		bool suppressed = false;
+		for (int cy = cy0; cy <= cy1 && !suppressed; cy++) {
+			for (int cx = cx0; cx <= cx1 && !suppressed; cx++) {
+				for (int slot : cells_[cy * cells + cx]) {
+					if (overlaps_slot(slot, x1, y1, x2, y2, area, iou_threshold)) {
+						suppressed = true;
+						break;
+					}
+				}
+			}
+		}
+		if (suppressed) {
+			continue;
+		}
+		int slot = (int)kept_.size();
+		keep(n, x1, y1, x2, y2, area);
+		for (int cy = cy0; cy <= cy1; cy++) {
+			for (int cx = cx0; cx <= cx1; cx++) {
+				cells_[cy * cells + cx].push_back(slot);
+			}
+		}
+	}
+	return kept_;
+}
@@ -0,0 +1,40 @@
+#ifndef __NMS_H__
+#define __NMS_H__
+
+#include <stddef.h>
+#include <vector>
+
+// Greedy class-aware non-maximum suppression over decoder candidates.
+//
+// Only the NMS_TOPK best candidates are considered, picked with a partial
+// selection before the one sort. Each class is shifted to its own region
+// of the plane (the class offset), so a single pass handles every class:
+// boxes of different classes can never overlap. A candidate is kept when
+// it overlaps no box kept before it; kept boxes are stored as separate
+// coordinate arrays and compared four at a time with NEON. In busy frames
+// the kept boxes are also bucketed on a coarse grid so a candidate is only
+// compared with its neighbours. Work is bounded by NMS_TOPK however
+// crowded the scene; every candidate that survives top-K is examined, so
+// the output is never cut short after suppression. The buffers are reused
+// between runs.
+class NmsEngine {
+    public:
+	void reserve(size_t candidates);
+
+	// boxes holds x, y, w, h per candidate. Returns the kept candidate
+	// indices by descending score, valid until the next run().
+	const std::vector<int> &run(const float *boxes, const float *scores, const int *class_ids, int count, float iou_threshold);
+
+    private:
+	std::vector<int> order_;
+	std::vector<int> kept_;
+	// Kept boxes, class-offset, one array per coordinate
+	std::vector<float> x1_, y1_, x2_, y2_, area_;
+	std::vector<std::vector<int> > cells_; // kept box slots per grid cell
+
+	void keep(int index, float x1, float y1, float x2, float y2, float area);
+	bool overlaps_kept(float x1, float y1, float x2, float y2, float area, float threshold) const;
+	bool overlaps_slot(int slot, float x1, float y1, float x2, float y2, float area, float threshold) const;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "npu_scheduler.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+int NpuScheduler::register_channel(const std::string &name, float weight, float target_fps, int deadline_ms)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	Channel ch;
+	ch.name = name;
+	ch.weight = std::max(weight, 0.01f);
+	ch.target_fps = std::max(target_fps, 0.f);
+	ch.deadline_us = (long long)deadline_ms * 1000;
+	// Start level with the busiest channel so a late joiner does not monopolise the NPU
+	for (const auto &other : channels_) {
+		ch.virtual_time = std::max(ch.virtual_time, other.virtual_time);
+	}
+	channels_.push_back(ch);
+	printf("NPU scheduler: channel %s weight=%.2f target=%.1ffps deadline=%dms\n", name.c_str(), ch.weight, ch.target_fps, deadline_ms);
+	return (int)channels_.size() - 1;
+}
+
+void NpuScheduler::set_concurrency(int grants)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	max_active_ = std::max(1, grants);
+}
+
+bool NpuScheduler::acquire(int id, long long frame_us)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	Channel &ch = channels_[id];
+	long long now = current_timestamp();
+	ch.waiting = true;
+	ch.granted = false;
+	ch.dropped = false;
+	ch.frame_us = frame_us;
+	ch.wait_start_us = now;
+
+	// A channel that sat idle must not bank credit: bring it up to the least-served waiter
+	double min_vt = -1.0;
+	for (const auto &other : channels_) {
+		if (&other != &ch && other.waiting && (min_vt < 0.0 || other.virtual_time < min_vt)) {
+			min_vt = other.virtual_time;
+		}
+	}
+	ch.virtual_time = std::max(ch.virtual_time, min_vt);
+
+	dispatch_locked(now);
+	cv_.wait(lock, [&ch] { return ch.granted || ch.dropped; });
+	ch.waiting = false;
+	return ch.granted;
+}
+
+void NpuScheduler::release(int id)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	Channel &ch = channels_[id];
+	long long now = current_timestamp();
+
+	ch.virtual_time += (now - ch.grant_us) / ch.weight;
+	ch.inferences++;
+	ch.window_inferences++;
+	ch.granted = false;
+	active_--;
+
+	update_rates_locked(now);
+	dispatch_locked(now);
+}
+
+void NpuScheduler::dispatch_locked(long long now_us)
+{
+	bool notify = false;
+
+	// Frames that can no longer make their deadline are not worth NPU time
+	for (auto &ch : channels_) {
+		if (ch.waiting && !ch.granted && !ch.dropped && ch.deadline_us > 0 && now_us - ch.frame_us > ch.deadline_us) {
+			ch.dropped = true;
+			ch.dropped_count++;
+			notify = true;
+		}
+	}
+
+	while (active_ < max_active_) {
+		Channel *best = nullptr;
+		bool best_due = false;
+		long long best_due_us = 0;
+		for (auto &ch : channels_) {
+			if (!ch.waiting || ch.granted || ch.dropped) {
+				continue;
+			}
+			long long due_us = ch.target_fps > 0.f ? ch.last_grant_us + (long long)(1000000.0f / ch.target_fps) : now_us + 1;
+			bool due = due_us <= now_us;
+			if (!best || (due && !best_due) || (due && best_due && due_us < best_due_us) ||
+			    (!due && !best_due && ch.virtual_time < best->virtual_time)) {
+				best = &ch;
+				best_due = due;
+				best_due_us = due_us;
+			}
+		}
+		if (!best) {
+			break;
+		}
+		active_++;
+		best->granted = true;
+		best->grant_us = now_us;
+		best->last_grant_us = now_us;
+		best->wait_total_us += now_us - best->wait_start_us;
+		notify = true;
+	}
+
+	if (notify) {
+		cv_.notify_all();
+	}
+}
+
+void NpuScheduler::update_rates_locked(long long now_us)
+{
+	if (window_start_us_ == 0) {
+		window_start_us_ = now_us;
+		return;
+	}
+	long long elapsed = now_us - window_start_us_;
+	if (elapsed < (long long)NPU_SCHED_REPORT_MS * 1000) {
+		return;
+	}
+
+	printf("NPU scheduler: achieved rates over %.1fs:", elapsed / 1000000.0);
+	for (auto &ch : channels_) {
+		ch.achieved_fps = ch.window_inferences * 1000000.0 / elapsed;
+		ch.window_inferences = 0;
+		printf(" %s=%.1f/%.1ffps(drop %lld)", ch.name.c_str(), ch.achieved_fps, ch.target_fps, ch.dropped_count);
+	}
+	printf("\n");
+	window_start_us_ = now_us;
+}
+
+std::vector<NpuScheduler::ChannelStats> NpuScheduler::get_stats()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::vector<ChannelStats> stats;
+	for (const auto &ch : channels_) {
+		ChannelStats s;
+		s.name = ch.name;
+		s.achieved_fps = ch.achieved_fps;
+		s.target_fps = ch.target_fps;
+		s.inferences = ch.inferences;
+		s.dropped = ch.dropped_count;
+		s.avg_wait_ms = ch.inferences > 0 ? ch.wait_total_us / 1000.0 / ch.inferences : 0.0;
+		stats.push_back(s);
+	}
+	return stats;
+}
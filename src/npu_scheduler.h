@@ -0,0 +1,80 @@
+#ifndef __NPU_SCHEDULER_H__
+#define __NPU_SCHEDULER_H__
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+// Arbitrates NPU access between channel threads.
+//
+// Each channel waits in acquire() with the capture time of the frame it
+// wants to infer; a channel only ever has that one frame pending. When the
+// NPU frees up, frames older than their channel's deadline are dropped and
+// the grant goes to:
+//   1. channels behind their target fps, earliest due time first (EDF);
+//   2. otherwise the channel with the least weighted NPU time (fair share).
+// Dropped channels go back to decoding, so the next attempt uses a newer frame.
+class NpuScheduler {
+    public:
+	struct ChannelStats {
+		std::string name;
+		double achieved_fps;
+		double target_fps;
+		long long inferences;
+		long long dropped;
+		double avg_wait_ms;
+	};
+
+	int register_channel(const std::string &name, float weight, float target_fps, int deadline_ms);
+
+	// Block until the channel may use the NPU. false: the frame missed its deadline.
+	bool acquire(int id, long long frame_us);
+	// Must follow every successful acquire()
+	void release(int id);
+
+	std::vector<ChannelStats> get_stats();
+
+	// Grants allowed at once; a batching broker downstream wants its batch size here
+	void set_concurrency(int grants);
+
+    private:
+	struct Channel {
+		std::string name;
+		float weight;
+		float target_fps;
+		long long deadline_us;
+
+		bool waiting = false;
+		bool granted = false;
+		bool dropped = false;
+		long long frame_us = 0;
+		long long wait_start_us = 0;
+
+		long long last_grant_us = 0;
+		long long grant_us = 0;
+		double virtual_time = 0.0; // NPU microseconds used, divided by weight
+
+		long long inferences = 0;
+		long long dropped_count = 0;
+		long long wait_total_us = 0;
+		long long window_inferences = 0;
+		double achieved_fps = 0.0;
+	};
+
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::deque<Channel> channels_; // deque: references stay valid while channels register
+	int active_ = 0;
+	int max_active_ = 1;
+	long long window_start_us_ = 0;
+
+	void dispatch_locked(long long now_us);
+	void update_rates_locked(long long now_us);
+};
+
+#endif
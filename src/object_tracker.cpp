@@ -0,0 +1,226 @@
+#include "object_tracker.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "box_utils.h"
+
+// Noise model relative to box height, as in ByteTrack
+static const float STD_WEIGHT_POSITION = 1.0f / 20;
+static const float STD_WEIGHT_VELOCITY = 1.0f / 160;
+
+void ObjectTracker::KalmanAxis::init(float z, float r)
+{
+	x = z;
+	v = 0.f;
+	p00 = r;
+	p01 = 0.f;
+	// Velocity is unknown on the first observation
+	p11 = r * 10.f;
+}
+
+void ObjectTracker::KalmanAxis::predict(float q_pos, float q_vel)
+{
+	x += v;
+	p00 += 2.f * p01 + p11 + q_pos;
+	p01 += p11;
+	p11 += q_vel;
+}
+
+void ObjectTracker::KalmanAxis::correct(float z, float r)
+{
+	float s = p00 + r;
+	float k0 = p00 / s;
+	float k1 = p01 / s;
+	float y = z - x;
+	x += k0 * y;
+	v += k1 * y;
+	p11 -= k1 * p01;
+	p01 *= (1.f - k0);
+	p00 *= (1.f - k0);
+}
+
+BOX_RECT ObjectTracker::Track::box() const
+{
+	BOX_RECT b;
+	b.left = (int)(cx.x - w.x / 2);
+	b.right = (int)(cx.x + w.x / 2);
+	b.top = (int)(cy.x - h.x / 2);
+	b.bottom = (int)(cy.x + h.x / 2);
+	return b;
+}
+
+ObjectTracker::ObjectTracker()
+{
+	tracks_.reserve(OBJ_NUMB_MAX_SIZE);
+}
+
+void ObjectTracker::set_max_interval(int frames)
+{
+	max_interval_ = std::max(1, frames);
+	interval_ = std::min(interval_, max_interval_);
+}
+
+bool ObjectTracker::should_run_inference(int frames)
+{
+	frames_since_inference_ += std::max(frames, 1);
+	if (frames_since_inference_ >= interval_) {
+		frames_since_inference_ = 0;
+		return true;
+	}
+	return false;
+}
+
+void ObjectTracker::predict(int frames)
+{
+	for (auto &t : tracks_) {
+		for (int step = 0; step < frames; step++) {
+			float h = std::max(t.h.x, 1.f);
+			float q_pos = (STD_WEIGHT_POSITION * h) * (STD_WEIGHT_POSITION * h);
+			float q_vel = (STD_WEIGHT_VELOCITY * h) * (STD_WEIGHT_VELOCITY * h);
+			t.cx.predict(q_pos, q_vel);
+			t.cy.predict(q_pos, q_vel);
+			t.w.predict(q_pos, q_vel);
+			t.h.predict(q_pos, q_vel);
+			// Keep the box from collapsing while coasting
+			t.w.x = std::max(t.w.x, 1.f);
+			t.h.x = std::max(t.h.x, 1.f);
+		}
+	}
+}
+
+void ObjectTracker::update(detect_result_group_t *detections)
+{
+	int det_count = detections->count;
+	det_used_.assign(det_count, false);
+	track_used_.assign(tracks_.size(), false);
+
+	// Greedy class-aware IoU association against the predicted boxes
+	float iou_sum = 0.f;
+	int matched = 0;
+	while (true) {
+		float best_iou = TRACKER_IOU_THRESH;
+		int best_t = -1, best_d = -1;
+		for (size_t t = 0; t < tracks_.size(); t++) {
+			if (track_used_[t]) {
+				continue;
+			}
+			BOX_RECT predicted = tracks_[t].box();
+			for (int d = 0; d < det_count; d++) {
+				if (det_used_[d] || tracks_[t].class_id != detections->results[d].class_id) {
+					continue;
+				}
+				float iou = box_iou(predicted, detections->results[d].box);
+				if (iou > best_iou) {
+					best_iou = iou;
+					best_t = t;
+					best_d = d;
+				}
+			}
+		}
+		if (best_t < 0) {
+			break;
+		}
+
+		Track &t = tracks_[best_t];
+		detect_result_t &det = detections->results[best_d];
+		float h = (float)std::max(det.box.bottom - det.box.top, 1);
+		float r = (STD_WEIGHT_POSITION * h) * (STD_WEIGHT_POSITION * h);
+		t.cx.correct((det.box.left + det.box.right) / 2.f, r);
+		t.cy.correct((det.box.top + det.box.bottom) / 2.f, r);
+		t.w.correct((float)(det.box.right - det.box.left), r);
+		t.h.correct(h, r);
+		t.prop = det.prop;
+		t.hits++;
+		t.misses = 0;
+		if (t.hits >= TRACKER_MIN_HITS) {
+			t.confirmed = true;
+		}
+		det.track_id = t.id;
+
+		track_used_[best_t] = true;
+		det_used_[best_d] = true;
+		iou_sum += best_iou;
+		matched++;
+	}
+
+	// Age unmatched tracks; losing a confirmed track means the scene changed
+	int lost_confirmed = 0;
+	for (size_t t = 0; t < tracks_.size(); t++) {
+		if (!track_used_[t]) {
+			tracks_[t].misses++;
+			if (tracks_[t].confirmed) {
+				lost_confirmed++;
+			}
+		}
+	}
+	tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(),
+				     [](const Track &t) { return t.misses > TRACKER_MAX_AGE || (!t.confirmed && t.misses > 0); }),
+		      tracks_.end());
+
+	// Unmatched detections start tentative tracks
+	int born = 0;
+	for (int d = 0; d < det_count; d++) {
+		if (det_used_[d]) {
+			continue;
+		}
+		detect_result_t &det = detections->results[d];
+		Track t;
+		t.id = next_track_id_++;
+		t.class_id = det.class_id;
+		t.name = det.name;
+		t.prop = det.prop;
+		float h = (float)std::max(det.box.bottom - det.box.top, 1);
+		float r = (STD_WEIGHT_POSITION * h) * (STD_WEIGHT_POSITION * h);
+		t.cx.init((det.box.left + det.box.right) / 2.f, r);
+		t.cy.init((det.box.top + det.box.bottom) / 2.f, r);
+		t.w.init((float)(det.box.right - det.box.left), r);
+		t.h.init(h, r);
+		t.hits = 1;
+		t.misses = 0;
+		t.confirmed = TRACKER_MIN_HITS <= 1;
+		det.track_id = t.id;
+		tracks_.push_back(t);
+		born++;
+	}
+
+	float mean_iou = matched > 0 ? iou_sum / matched : 1.f;
+	adapt_interval(born == 0 && lost_confirmed == 0 && mean_iou >= TRACKER_STABLE_IOU);
+}
+
+void ObjectTracker::adapt_interval(bool stable)
+{
+	if (!stable) {
+		// Run the detector on every frame until tracks settle again
+		if (interval_ != 1) {
+			printf("Tracker: tracks unstable, inference interval %d -> 1\n", interval_);
+		}
+		interval_ = 1;
+		stable_updates_ = 0;
+		return;
+	}
+
+	if (++stable_updates_ >= TRACKER_STABLE_UPDATES && interval_ < max_interval_) {
+		interval_++;
+		stable_updates_ = 0;
+		printf("Tracker: tracks stable, inference interval -> %d\n", interval_);
+	}
+}
+
+void ObjectTracker::get_tracked(detect_result_group_t *out) const
+{
+	out->clear();
+	for (const auto &t : tracks_) {
+		if (!t.confirmed) {
+			continue;
+		}
+		detect_result_t &res = out->add();
+		res.class_id = t.class_id;
+		res.name = t.name;
+		res.box = t.box();
+		res.prop = t.prop;
+		res.track_id = t.id;
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef __OBJECT_TRACKER_H__
+#define __OBJECT_TRACKER_H__
+
+#include <stddef.h>
+#include <vector>
+
+#include "config.h"
+#include "yolov5s_postprocess.h"
+
+// SORT-style multi-object tracker.
+//
+// Every track carries a constant-velocity Kalman filter over its box
+// center and size. Tracks are predicted once per decoded frame and
+// corrected by greedy, class-aware IoU matching whenever the detector
+// runs, so boxes keep moving on frames where inference is skipped.
+//
+// The tracker also owns the adaptive inference interval: it runs the
+// detector every frame while tracks are appearing, disappearing or
+// drifting, and backs off towards the configured maximum while the
+// scene is stable.
+class ObjectTracker {
+    public:
+	ObjectTracker();
+
+	// Advance every track by frames source frames: those elapsed since the
+	// previous call, skipped or dropped ones included. Call once per processed frame.
+	void predict(int frames = 1);
+
+	// Correct tracks with fresh detections. Assigns track_id to every detection in place.
+	void update(detect_result_group_t *detections);
+
+	// Confirmed tracks at their current position, for frames without inference.
+	void get_tracked(detect_result_group_t *out) const;
+
+	// Whether the detector should run on the frame about to be processed,
+	// frames source frames after the previous one. The interval is in source frames.
+	bool should_run_inference(int frames = 1);
+
+	void set_max_interval(int frames);
+	int max_interval() const
+	{
+		return max_interval_;
+	}
+	int interval() const
+	{
+		return interval_;
+	}
+	int track_count() const
+	{
+		return (int)tracks_.size();
+	}
+
+    private:
+	// One box coordinate: position and velocity with a 2x2 covariance
+	struct KalmanAxis {
+		float x, v;
+		float p00, p01, p11;
+
+		void init(float z, float r);
+		void predict(float q_pos, float q_vel);
+		void correct(float z, float r);
+	};
+
+	struct Track {
+		int id;
+		int class_id;
+		const char *name;
+		float prop;
+		KalmanAxis cx, cy, w, h;
+		int hits;
+		int misses; // consecutive inference updates without a match
+		bool confirmed;
+
+		BOX_RECT box() const;
+	};
+
+	std::vector<Track> tracks_;
+	int next_track_id_ = 1;
+
+	int max_interval_ = INFERENCE_INTERVAL_DEFAULT;
+	int interval_ = 1;
+	int frames_since_inference_ = 0;
+	int stable_updates_ = 0;
+
+	// Scratch for association, kept to avoid per-frame allocation
+	std::vector<bool> det_used_;
+	std::vector<bool> track_used_;
+
+	void adapt_interval(bool stable);
+};
+
+#endif
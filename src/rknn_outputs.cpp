@@ -0,0 +1,48 @@
+#include "rknn_outputs.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int RknnOutputWorkspace::init(const rknn_tensor_attr *attrs, int n_output)
+{
+	if (!attrs || n_output <= 0) {
+		return -1;
+	}
+	storage_.assign(n_output, std::vector<int8_t>());
+	buffers_.assign(n_output, nullptr);
+	outputs_.resize(n_output);
+
+	size_t total = 0;
+	for (int i = 0; i < n_output; i++) {
+		// Quantized outputs come back as one byte per element
+		size_t size = attrs[i].n_elems;
+		if (size == 0) {
+			printf("RKNN output %d has no elements\n", i);
+			return -1;
+		}
+		storage_[i].resize(size);
+		buffers_[i] = storage_[i].data();
+		total += size;
+
+		memset(&outputs_[i], 0, sizeof(rknn_output));
+		outputs_[i].index = i;
+		outputs_[i].want_float = 0;
+		outputs_[i].is_prealloc = 1;
+		outputs_[i].buf = buffers_[i];
+		outputs_[i].size = size;
+	}
+	printf("RKNN output workspace: %d outputs, %zu bytes\n", n_output, total);
+	return 0;
+}
+
+int RknnOutputWorkspace::fetch(rknn_context ctx)
+{
+	int ret = rknn_outputs_get(ctx, outputs_.size(), outputs_.data(), NULL);
+	if (ret < 0) {
+		printf("rknn_outputs_get failed: %d\n", ret);
+		return ret;
+	}
+	// Nothing to free with preallocated buffers; this only ends the runtime's bookkeeping for the run
+	rknn_outputs_release(ctx, outputs_.size(), outputs_.data());
+	return 0;
+}
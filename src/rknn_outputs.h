@@ -0,0 +1,38 @@
+#ifndef __RKNN_OUTPUTS_H__
+#define __RKNN_OUTPUTS_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "rknn_api.h"
+
+// Output buffers of one RKNN context, allocated once and reused every run.
+//
+// rknn_outputs_get() writes into them (is_prealloc), so fetching a frame's
+// outputs allocates nothing and the pointers handed to the decoders stay
+// valid until the next fetch. The quantization parameters live in the
+// attrs the workspace was sized from; it keeps no copy of them.
+class RknnOutputWorkspace {
+    public:
+	// Size one int8 buffer per output from attrs. Returns 0, or -1 on bad attrs.
+	int init(const rknn_tensor_attr *attrs, int n_output);
+
+	// Copy the last run's outputs of ctx into the buffers
+	int fetch(rknn_context ctx);
+
+	int count() const
+	{
+		return (int)outputs_.size();
+	}
+	int8_t *const *buffers() const
+	{
+		return buffers_.data();
+	}
+
+    private:
+	std::vector<std::vector<int8_t> > storage_;
+	std::vector<int8_t *> buffers_;
+	std::vector<rknn_output> outputs_;
+};
+
+#endif
@@ -59,7 +59,8 @@ void rknn_drm_deinit(drm_context *drm_ctx, int drm_fd)
     }
 }
 
-void *rknn_drm_buf_alloc(drm_context *drm_ctx, int drm_fd, int TexWidth, int TexHeight, int bpp, int *fd, unsigned int *handle, size_t *actual_size)
+void *rknn_drm_buf_alloc(drm_context *drm_ctx, int drm_fd, int TexWidth, int TexHeight, int bpp, int *fd, unsigned int *handle, size_t *actual_size,
+                         unsigned int *pitch)
 {
     int ret;
     if (drm_ctx == NULL)
@@ -95,6 +96,10 @@ void *rknn_drm_buf_alloc(drm_context *drm_ctx, int drm_fd, int TexWidth, int Tex
     {
         *actual_size = alloc_arg.size;
     }
+    if (pitch != NULL)
+    {
+        *pitch = alloc_arg.pitch;
+    }
 
     memset(&fd_args, 0, sizeof(fd_args));
     fd_args.fd = -1;
@@ -27,7 +27,8 @@ extern "C"
 
     int rknn_drm_init(drm_context *drm_ctx);
 
-    void *rknn_drm_buf_alloc(drm_context *drm_ctx, int drm_fd, int TexWidth, int TexHeight, int bpp, int *fd, unsigned int *handle, size_t *actual_size);
+    void *rknn_drm_buf_alloc(drm_context *drm_ctx, int drm_fd, int TexWidth, int TexHeight, int bpp, int *fd, unsigned int *handle, size_t *actual_size,
+                             unsigned int *pitch = NULL);
 
     int rknn_drm_buf_destroy(drm_context *drm_ctx, int drm_fd, int buf_fd, int handle, void *drm_buf, size_t size);
 
@@ -33,6 +33,9 @@ int rknn_rga_init(rga_context *rga_ctx)
         return -1;
     }
 
+    // Color fill is missing from some librga builds; callers fall back to memset
+    rga_ctx->fill_func = (FUNC_RGA_COLORFILL)dlsym(rga_ctx->rga_handle, "c_RkRgaColorFill");
+
     rga_ctx->init_func();
     return 0;
 #else
@@ -203,7 +206,10 @@ int rknn_img_resize_virt_to_virt(rga_context *rga_ctx, void *src_virt, int src_w
 #endif
 }
 
-int rknn_img_resize_phy_to_phy_stride(rga_context *rga_ctx, int src_fd, int src_w, int src_h, int src_stride, int src_fmt, uint64_t dst_fd, int dst_w, int dst_h, int dst_fmt)
+int rknn_img_crop_resize_phy_to_phy_stride(rga_context *rga_ctx, int src_fd, int src_w, int src_h, int src_stride, int src_fmt,
+                                           int crop_x, int crop_y, int crop_w, int crop_h,
+                                           uint64_t dst_fd, int dst_w, int dst_h, int dst_stride,
+                                           int dst_x, int dst_y, int dst_rect_w, int dst_rect_h, int dst_fmt)
 {
 #if !ENABLE_RGA_HARDWARE
     // RGA disabled - return error to trigger software fallback
@@ -226,6 +232,16 @@ int rknn_img_resize_phy_to_phy_stride(rga_context *rga_ctx, int src_fd, int src_
         return -1;
     }
 
+    if (crop_x < 0 || crop_y < 0 || crop_w <= 0 || crop_h <= 0 || crop_x + crop_w > src_w || crop_y + crop_h > src_h) {
+        printf("Invalid crop rect: %d,%d %dx%d in %dx%d\n", crop_x, crop_y, crop_w, crop_h, src_w, src_h);
+        return -1;
+    }
+
+    if (dst_x < 0 || dst_y < 0 || dst_rect_w <= 0 || dst_rect_h <= 0 || dst_x + dst_rect_w > dst_w || dst_y + dst_rect_h > dst_h) {
+        printf("Invalid dst rect: %d,%d %dx%d in %dx%d\n", dst_x, dst_y, dst_rect_w, dst_rect_h, dst_w, dst_h);
+        return -1;
+    }
+
     if (src_stride < src_w) {
         printf("Invalid stride %d < width %d, using width as stride\n", src_stride, src_w);
         src_stride = src_w;
@@ -241,6 +257,7 @@ int rknn_img_resize_phy_to_phy_stride(rga_context *rga_ctx, int src_fd, int src_
     memset(&src, 0, sizeof(rga_info_t));
     src.fd = src_fd;
     src.mmuFlag = 1;
+    src.color_space_mode = rga_ctx->color_space_mode;
     // src.rotation = rotation;
 
     memset(&dst, 0, sizeof(rga_info_t));
@@ -248,20 +265,19 @@ int rknn_img_resize_phy_to_phy_stride(rga_context *rga_ctx, int src_fd, int src_
     dst.mmuFlag = 0;
     dst.nn.nn_flag = 0;
 
-    // Calculate proper stride for different formats
-    int dst_stride = dst_w;
-
-    // For RGB formats, stride equals width (not width * bytes_per_pixel)
-    if (dst_fmt == RK_FORMAT_RGB_888 || dst_fmt == RK_FORMAT_BGR_888) {
-        dst_stride = dst_w;  // RGA expects width, not byte stride
+    // RGA expects the stride in pixels, not bytes; it comes from the pitch the allocator chose
+    if (dst_stride < dst_w) {
+        printf("Invalid dst stride %d < width %d, using width as stride\n", dst_stride, dst_w);
+        dst_stride = dst_w;
     }
 
     // CRITICAL: Use actual stride for source, not just width
     printf("DEBUG: RGA stride-aware processing: src=%dx%d(stride=%d), dst=%dx%d(stride=%d)\n",
            src_w, src_h, src_stride, dst_w, dst_h, dst_stride);
 
-    rga_set_rect(&src.rect, 0, 0, src_w, src_h, src_stride, src_h, src_fmt);
-    rga_set_rect(&dst.rect, 0, 0, dst_w, dst_h, dst_stride, dst_h, dst_fmt);
+    // The crop rect selects the region inside the full (stride x height) source plane
+    rga_set_rect(&src.rect, crop_x, crop_y, crop_w, crop_h, src_stride, src_h, src_fmt);
+    rga_set_rect(&dst.rect, dst_x, dst_y, dst_rect_w, dst_rect_h, dst_stride, dst_h, dst_fmt);
 
     ret = rga_ctx->blit_func(&src, &dst, NULL);
     if (ret != 0) {
@@ -275,6 +291,35 @@ int rknn_img_resize_phy_to_phy_stride(rga_context *rga_ctx, int src_fd, int src_
 #endif
 }
 
+int rknn_img_resize_phy_to_phy_stride(rga_context *rga_ctx, int src_fd, int src_w, int src_h, int src_stride, int src_fmt, uint64_t dst_fd, int dst_w, int dst_h, int dst_fmt)
+{
+    return rknn_img_crop_resize_phy_to_phy_stride(rga_ctx, src_fd, src_w, src_h, src_stride, src_fmt,
+                                                  0, 0, src_w, src_h, dst_fd, dst_w, dst_h, dst_w, 0, 0, dst_w, dst_h, dst_fmt);
+}
+
+int rknn_img_fill_phy(rga_context *rga_ctx, uint64_t dst_fd, int dst_w, int dst_h, int dst_fmt,
+                      int x, int y, int w, int h, unsigned int color)
+{
+#if !ENABLE_RGA_HARDWARE
+    return -1;
+#else
+    if (!rga_ctx || !rga_ctx->rga_handle || !rga_ctx->fill_func) {
+        return -1;
+    }
+
+    rga_info_t dst;
+
+    memset(&dst, 0, sizeof(rga_info_t));
+    dst.fd = dst_fd;
+    dst.mmuFlag = 1;
+    dst.color = color;
+
+    rga_set_rect(&dst.rect, x, y, w, h, dst_w, dst_h, dst_fmt);
+
+    return rga_ctx->fill_func(&dst);
+#endif
+}
+
 int rknn_rga_deinit(rga_context *rga_ctx)
 {
 #if ENABLE_RGA_HARDWARE
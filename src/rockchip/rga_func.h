@@ -12,6 +12,7 @@ extern "C"
     typedef int (*FUNC_RGA_INIT)();
     typedef void (*FUNC_RGA_DEINIT)();
     typedef int (*FUNC_RGA_BLIT)(rga_info_t *, rga_info_t *, rga_info_t *);
+    typedef int (*FUNC_RGA_COLORFILL)(rga_info_t *);
 
     typedef struct _rga_context
     {
@@ -19,14 +20,33 @@ extern "C"
         FUNC_RGA_INIT init_func;
         FUNC_RGA_DEINIT deinit_func;
         FUNC_RGA_BLIT blit_func;
+        FUNC_RGA_COLORFILL fill_func; // optional, NULL when librga does not export it
+        int color_space_mode;         // YUV->RGB mode of blits from YUV sources, 0 for the driver default
     } rga_context;
 
+// rga_info_t.color_space_mode values (librga IM_YUV_TO_RGB_*)
+#define RGA_YUV_TO_RGB_BT601_LIMIT (1 << 0)
+#define RGA_YUV_TO_RGB_BT601_FULL (2 << 0)
+#define RGA_YUV_TO_RGB_BT709_LIMIT (3 << 0)
+
     int rknn_rga_init(rga_context *rga_ctx);
 
     int rknn_img_resize_phy_to_phy(rga_context *rga_ctx, int src_fd, int src_w, int src_h, int src_fmt, uint64_t dst_fd, int dst_w, int dst_h, int dst_fmt);
 
     int rknn_img_resize_phy_to_phy_stride(rga_context *rga_ctx, int src_fd, int src_w, int src_h, int src_stride, int src_fmt, uint64_t dst_fd, int dst_w, int dst_h, int dst_fmt);
 
+    // Same as above, but only the source rectangle (crop_x, crop_y, crop_w, crop_h) is scaled,
+    // into the rectangle (dst_x, dst_y, dst_rect_w, dst_rect_h) of the dst_w x dst_h buffer
+    // whose rows are dst_stride pixels apart
+    int rknn_img_crop_resize_phy_to_phy_stride(rga_context *rga_ctx, int src_fd, int src_w, int src_h, int src_stride, int src_fmt,
+                                               int crop_x, int crop_y, int crop_w, int crop_h,
+                                               uint64_t dst_fd, int dst_w, int dst_h, int dst_stride,
+                                               int dst_x, int dst_y, int dst_rect_w, int dst_rect_h, int dst_fmt);
+
+    // Fill a rectangle of a dst_w x dst_h buffer with a solid color (0xAABBGGRR); dst_w is the row stride in pixels
+    int rknn_img_fill_phy(rga_context *rga_ctx, uint64_t dst_fd, int dst_w, int dst_h, int dst_fmt,
+                          int x, int y, int w, int h, unsigned int color);
+
     int rknn_img_resize_phy_to_virt(rga_context *rga_ctx, int src_fd, int src_w, int src_h, int src_fmt, void *dst_virt, int dst_w, int dst_h, int dst_fmt);
 
     int rknn_img_resize_virt_to_phy(rga_context *rga_ctx, void *src_virt, int src_w, int src_h, int src_fmt, uint64_t dst_fd, int dst_w, int dst_h, int dst_fmt);
@@ -0,0 +1,136 @@
+#include "stream_open.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+static const OpenProfile OPEN_PROFILES[] = {
+	{ "default", 0, 0 },
+	// IP cameras announce codec and extradata in the SDP; a few packets confirm the rest
+	{ "camera", 65536, 500000 },
+	// Known cameras with in-band SPS on every keyframe
+	{ "fast", 32768, 100000 },
+};
+
+bool is_live_source(const char *url)
+{
+	return strstr(url, "://") && strncmp(url, "file:", 5) != 0;
+}
+
+const OpenProfile &find_open_profile(const std::string &name, const char *url)
+{
+	std::string wanted = name;
+	if (wanted == "auto") {
+		wanted = is_live_source(url) ? "camera" : "default";
+	}
+	for (const auto &profile : OPEN_PROFILES) {
+		if (wanted == profile.name) {
+			return profile;
+		}
+	}
+	printf("WARNING: Unknown open profile '%s', using default\n", name.c_str());
+	return OPEN_PROFILES[0];
+}
+
+StreamInfoCache &StreamInfoCache::instance()
+{
+	static StreamInfoCache cache;
+	return cache;
+}
+
+StreamInfoCache::~StreamInfoCache()
+{
+	for (auto &it : entries_) {
+		avcodec_parameters_free(&it.second.par);
+	}
+}
+
+bool StreamInfoCache::apply(const std::string &url, AVStream *stream)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = entries_.find(url);
+	if (it == entries_.end()) {
+		return false;
+	}
+	// The camera may have been reconfigured; the demuxer's codec id has the final say
+	if (it->second.par->codec_id != stream->codecpar->codec_id) {
+		avcodec_parameters_free(&it->second.par);
+		entries_.erase(it);
+		return false;
+	}
+	if (avcodec_parameters_copy(stream->codecpar, it->second.par) < 0) {
+		return false;
+	}
+	stream->time_base = it->second.time_base;
+	stream->avg_frame_rate = it->second.avg_frame_rate;
+	return true;
+}
+
+void StreamInfoCache::store(const std::string &url, const AVStream *stream)
+{
+	AVCodecParameters *par = avcodec_parameters_alloc();
+	if (!par || avcodec_parameters_copy(par, stream->codecpar) < 0) {
+		avcodec_parameters_free(&par);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = entries_.find(url);
+	if (it != entries_.end()) {
+		avcodec_parameters_free(&it->second.par);
+	}
+	Entry &entry = entries_[url];
+	entry.par = par;
+	entry.time_base = stream->time_base;
+	entry.avg_frame_rate = stream->avg_frame_rate;
+}
+
+void StreamInfoCache::invalidate(const std::string &url)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto it = entries_.find(url);
+	if (it != entries_.end()) {
+		avcodec_parameters_free(&it->second.par);
+		entries_.erase(it);
+	}
+}
+
+AVFormatContext *open_stream_input(const std::string &url, const OpenProfile &profile)
+{
+	long long start_us = current_timestamp();
+
+	AVDictionary *opts = NULL;
+	av_dict_set(&opts, "rtsp_transport", "+udp+tcp", 0);
+	av_dict_set(&opts, "rtsp_flags", "+prefer_tcp", 0);
+	av_dict_set(&opts, "threads", "auto", 0);
+	if (profile.probesize > 0) {
+		av_dict_set_int(&opts, "probesize", profile.probesize, 0);
+	}
+	if (profile.analyzeduration_us > 0) {
+		av_dict_set_int(&opts, "analyzeduration", profile.analyzeduration_us, 0);
+	}
+
+	AVFormatContext *format_context = avformat_alloc_context();
+	int ret = avformat_open_input(&format_context, url.c_str(), NULL, &opts);
+	av_dict_free(&opts);
+	if (ret < 0) {
+		printf("avformat_open_input filed: %d\n", ret);
+		return nullptr;
+	}
+
+	int video_index = av_find_best_stream(format_context, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+	bool cached = video_index >= 0 && StreamInfoCache::instance().apply(url, format_context->streams[video_index]);
+	if (!cached) {
+		ret = avformat_find_stream_info(format_context, NULL);
+		if (ret < 0) {
+			printf("avformat_find_stream_info filed: %d\n", ret);
+			avformat_close_input(&format_context);
+			return nullptr;
+		}
+	}
+
+	printf("OPEN: %s in %.1fms (profile %s, %s)\n", url.c_str(), (current_timestamp() - start_us) / 1000.0, profile.name,
+	       cached ? "cached stream info" : "probed");
+	return format_context;
+}
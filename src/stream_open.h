@@ -0,0 +1,60 @@
+#ifndef __STREAM_OPEN_H__
+#define __STREAM_OPEN_H__
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <libavformat/avformat.h>
+#ifdef __cplusplus
+}
+#endif
+
+// Network streams keep producing frames whether or not we keep up; files do not
+bool is_live_source(const char *url);
+
+// How hard avformat probes a source before the first packet is read.
+// Zero leaves the FFmpeg default (5MB / 5s).
+struct OpenProfile {
+	const char *name;
+	int64_t probesize;
+	int64_t analyzeduration_us;
+};
+
+// "default", "camera", "fast" or "auto" (camera for network sources, default for files).
+// Unknown names fall back to "default".
+const OpenProfile &find_open_profile(const std::string &name, const char *url);
+
+// Video codec parameters of the last session that decoded a frame, per URL.
+// A reconnect with a cache hit skips avformat_find_stream_info entirely.
+class StreamInfoCache {
+    public:
+	static StreamInfoCache &instance();
+
+	// Copy the cached parameters into stream when the codec matches. Returns true on a hit.
+	bool apply(const std::string &url, AVStream *stream);
+	void store(const std::string &url, const AVStream *stream);
+	void invalidate(const std::string &url);
+
+    private:
+	StreamInfoCache() {}
+	~StreamInfoCache();
+
+	struct Entry {
+		AVCodecParameters *par;
+		AVRational time_base;
+		AVRational avg_frame_rate;
+	};
+	std::mutex mutex_;
+	std::map<std::string, Entry> entries_;
+};
+
+// Open and probe url with the given profile, using cached stream info when available.
+// Safe to call from several threads at once. Returns nullptr on failure.
+AVFormatContext *open_stream_input(const std::string &url, const OpenProfile &profile);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __TRIPLE_BUFFER_H__
+#define __TRIPLE_BUFFER_H__
+
+#include <atomic>
+
+// Lock-free latest-value mailbox between one producer and one consumer.
+//
+// Three preallocated slots rotate between the two threads: the producer
+// fills its back slot and swaps it into the middle, the consumer swaps its
+// front slot for the middle when that holds something new. Neither side
+// ever waits for the other. A published value the consumer has not picked
+// up yet is handed back to the producer on the next publish and refilled,
+// so superseded values are never consumed and nothing is allocated after
+// the slots are set up.
+template <typename T> class TripleBuffer {
+    public:
+	TripleBuffer() : middle_(1), back_(0), front_(2)
+	{
+	}
+
+	// Producer side: the slot to fill. It stays the producer's until publish().
+	T &back()
+	{
+		return slots_[back_];
+	}
+
+	// Hand the back slot to the consumer. Returns true if the previously
+	// published value was never taken (it is now the new back slot).
+	bool publish()
+	{
+		int prev = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+		back_ = prev & INDEX_MASK;
+		return (prev & FRESH) != 0;
+	}
+
+	// Consumer side: make the newest published value the front slot.
+	// Returns false if nothing was published since the last take().
+	bool take()
+	{
+		if (!(middle_.load(std::memory_order_acquire) & FRESH)) {
+			return false;
+		}
+		int prev = middle_.exchange(front_, std::memory_order_acq_rel);
+		front_ = prev & INDEX_MASK;
+		return true;
+	}
+
+	// The slot the last successful take() returned; the consumer's until the next take()
+	T &front()
+	{
+		return slots_[front_];
+	}
+
+	// Forget a pending value. Only while neither side is using the buffer.
+	void discard()
+	{
+		middle_.fetch_and(INDEX_MASK, std::memory_order_acq_rel);
+	}
+
+	// Every slot, for setting them up before either side starts
+	T &slot(int index)
+	{
+		return slots_[index];
+	}
+
+	static const int SLOT_COUNT = 3;
+
+    private:
+	static const int INDEX_MASK = 3;
+	static const int FRESH = 4; // the middle slot holds a value not taken yet
+
+	T slots_[SLOT_COUNT];
+	std::atomic<int> middle_; // index of the middle slot | FRESH
+	int back_; // producer only
+	int front_; // consumer only
+};
+
+#endif
@@ -1,14 +1,17 @@
 #ifndef _RKNN_ZERO_COPY_DEMO_POSTPROCESS_H_
 #define _RKNN_ZERO_COPY_DEMO_POSTPROCESS_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <vector>
 
+#include "nms.h"
+
 #define LABEL_NALE_TXT_PATH "./model/coco_80_labels_list.txt"
 #define MODEL_PATH "./model/yolov5s-640-640.rknn"
 
-#define OBJ_NAME_MAX_SIZE 16
-#define OBJ_NUMB_MAX_SIZE 64
+#define OBJ_NUMB_MAX_SIZE 64 // typical detections per frame, reserved up front; groups grow past it
+#define OBJ_CANDIDATE_RESERVE 1024 // decoder candidates reserved up front
 #define OBJ_CLASS_NUM 80
 #define NMS_THRESH 0.6
 #define BOX_THRESH 0.5
@@ -22,19 +25,63 @@ typedef struct _BOX_RECT {
 } BOX_RECT;
 
 typedef struct __detect_result_t {
-	char name[OBJ_NAME_MAX_SIZE];
+	int class_id; // index into the model's classes; compare this, not the name
+	const char *name; // label of class_id in the process-wide label table, never freed
 	BOX_RECT box;
 	float prop;
+	int track_id; // 0 until assigned by the tracker
 } detect_result_t;
 
+// The detections of one frame. results holds exactly count entries; it
+// keeps its capacity across clear(), so a group reused from frame to frame
+// stops allocating once it has held the busiest scene.
 typedef struct _detect_result_group_t {
-	int id;
-	int count;
-	detect_result_t results[OBJ_NUMB_MAX_SIZE];
+	int id = 0;
+	int count = 0;
+	std::vector<detect_result_t> results;
+
+	void clear()
+	{
+		results.clear();
+		count = 0;
+	}
+	// A zeroed entry at the end
+	detect_result_t &add()
+	{
+		results.emplace_back();
+		count = (int)results.size();
+		return results.back();
+	}
 } detect_result_group_t;
 
-int post_process(int8_t *input0, int8_t *input1, int8_t *input2, int model_in_h, int model_in_w, float conf_threshold, float nms_threshold, float scale_w, float scale_h, std::vector<int32_t> &qnt_zps,
-		 std::vector<float> &qnt_scales, detect_result_group_t *group);
+// Candidate boxes of one frame and the buffers filtering them needs.
+// Owned by a decoder and reused, so steady-state frames do not allocate.
+struct DetectionScratch {
+	std::vector<float> boxes; // x, y, w, h per candidate, in model input pixels
+	std::vector<float> probs;
+	std::vector<int> class_ids;
+	NmsEngine nms;
+
+	void reserve(size_t candidates)
+	{
+		boxes.reserve(candidates * 4);
+		probs.reserve(candidates);
+		class_ids.reserve(candidates);
+		nms.reserve(candidates);
+	}
+	void clear()
+	{
+		boxes.clear();
+		probs.clear();
+		class_ids.clear();
+	}
+};
+
+// Shared tail of every detection decoder: candidates go through class-aware
+// NMS into the result group, highest score first
+int filter_detections(DetectionScratch &scratch, int model_in_h, int model_in_w, float nms_threshold, float scale_w, float scale_h,
+		      const char *const *label_names, int num_labels, detect_result_group_t *group);
+
+int readLines(const char *fileName, char *lines[], int max_line);
 
-void deinitPostProcess();
 #endif //_RKNN_ZERO_COPY_DEMO_POSTPROCESS_H_